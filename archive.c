@@ -0,0 +1,792 @@
+#include "archive.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <endian.h>
+#include <sys/stat.h>
+
+#define US_PER_HOUR 3600000000ull
+
+/// @brief побитовая запись, старший бит первым
+typedef struct
+{
+    uint8_t *data;
+    size_t len;
+    size_t bit;
+} bit_writer;
+
+typedef struct
+{
+    const uint8_t *data;
+    size_t len;
+    size_t bit;
+} bit_reader;
+
+static inline bool bw_put(bit_writer *bw, uint64_t value, unsigned nbits)
+{
+    if (bw->bit + nbits > bw->len * 8)
+        return false;
+
+    while (nbits > 0)
+    {
+        size_t byte = bw->bit >> 3;
+        unsigned used = bw->bit & 7;
+        unsigned room = 8 - used;
+        unsigned take = nbits < room ? nbits : room;
+        uint8_t part = (uint8_t)((value >> (nbits - take)) & ((1u << take) - 1));
+
+        if (used == 0)
+            bw->data[byte] = 0;
+        bw->data[byte] |= (uint8_t)(part << (room - take));
+        bw->bit += take;
+        nbits -= take;
+    }
+    return true;
+}
+
+static inline bool br_get(bit_reader *br, unsigned nbits, uint64_t *value)
+{
+    if (br->bit + nbits > br->len * 8)
+        return false;
+
+    uint64_t result = 0;
+    while (nbits > 0)
+    {
+        size_t byte = br->bit >> 3;
+        unsigned used = br->bit & 7;
+        unsigned room = 8 - used;
+        unsigned take = nbits < room ? nbits : room;
+        uint8_t part = (uint8_t)((br->data[byte] >> (room - take)) & ((1u << take) - 1));
+
+        result = (result << take) | part;
+        br->bit += take;
+        nbits -= take;
+    }
+    *value = result;
+    return true;
+}
+
+static inline uint32_t zigzag32(int32_t v)
+{
+    return ((uint32_t)v << 1) ^ (uint32_t)(v >> 31);
+}
+
+static inline int32_t unzigzag32(uint32_t v)
+{
+    return (int32_t)(v >> 1) ^ -(int32_t)(v & 1);
+}
+
+static inline uint64_t zigzag64(int64_t v)
+{
+    return ((uint64_t)v << 1) ^ (uint64_t)(v >> 63);
+}
+
+static inline int64_t unzigzag64(uint64_t v)
+{
+    return (int64_t)(v >> 1) ^ -(int64_t)(v & 1);
+}
+
+static inline uint32_t float_bits(float f)
+{
+    uint32_t u;
+    memcpy(&u, &f, sizeof(u));
+    return u;
+}
+
+static inline float bits_float(uint32_t u)
+{
+    float f;
+    memcpy(&f, &u, sizeof(f));
+    return f;
+}
+
+/// @brief delta-of-delta времени по схеме Gorilla: '0' | '10'+7 | '110'+9 | '1110'+12 | '1111'+32 бита
+static bool put_dod(bit_writer *bw, int64_t dod)
+{
+    uint64_t z = zigzag64(dod);
+
+    if (dod == 0)
+        return bw_put(bw, 0x0, 1);
+    if (z < (1u << 7))
+        return bw_put(bw, 0x2, 2) && bw_put(bw, z, 7);
+    if (z < (1u << 9))
+        return bw_put(bw, 0x6, 3) && bw_put(bw, z, 9);
+    if (z < (1u << 12))
+        return bw_put(bw, 0xE, 4) && bw_put(bw, z, 12);
+    return bw_put(bw, 0xF, 4) && bw_put(bw, z, 32);
+}
+
+static bool get_dod(bit_reader *br, int64_t *dod)
+{
+    uint64_t bit, z;
+    unsigned prefix = 0;
+
+    while (prefix < 4)
+    {
+        if (!br_get(br, 1, &bit))
+            return false;
+        if (bit == 0)
+            break;
+        prefix++;
+    }
+
+    switch (prefix)
+    {
+    case 0:
+        *dod = 0;
+        return true;
+    case 1:
+        if (!br_get(br, 7, &z)) return false;
+        break;
+    case 2:
+        if (!br_get(br, 9, &z)) return false;
+        break;
+    case 3:
+        if (!br_get(br, 12, &z)) return false;
+        break;
+    default:
+        if (!br_get(br, 32, &z)) return false;
+        break;
+    }
+    *dod = unzigzag64(z);
+    return true;
+}
+
+/// @brief разность двух int16 в zigzag-varint, по 7 бит на байт
+static bool put_varint(bit_writer *bw, uint32_t v)
+{
+    while (v >= 0x80)
+    {
+        if (!bw_put(bw, (v & 0x7F) | 0x80, 8))
+            return false;
+        v >>= 7;
+    }
+    return bw_put(bw, v, 8);
+}
+
+static bool get_varint(bit_reader *br, uint32_t *v)
+{
+    uint64_t byte;
+    uint32_t result = 0;
+
+    for (unsigned shift = 0; shift < 32; shift += 7)
+    {
+        if (!br_get(br, 8, &byte))
+            return false;
+        result |= (uint32_t)(byte & 0x7F) << shift;
+        if (!(byte & 0x80))
+        {
+            *v = result;
+            return true;
+        }
+    }
+    return false;
+}
+
+/// @brief состояние XOR-кодирования одного float канала (Gorilla)
+typedef struct
+{
+    uint32_t prev;
+    unsigned lead;
+    unsigned trail;
+    bool window;
+} xor_state;
+
+static bool put_xor(bit_writer *bw, xor_state *st, float value)
+{
+    uint32_t cur = float_bits(value);
+    uint32_t x = cur ^ st->prev;
+    st->prev = cur;
+
+    if (x == 0)
+        return bw_put(bw, 0, 1);
+
+    unsigned lead = __builtin_clz(x);
+    unsigned trail = __builtin_ctz(x);
+    if (lead > 31)
+        lead = 31;
+
+    if (st->window && lead >= st->lead && trail >= st->trail)
+    {
+        unsigned len = 32 - st->lead - st->trail;
+        return bw_put(bw, 0x2, 2) && bw_put(bw, x >> st->trail, len);
+    }
+
+    unsigned len = 32 - lead - trail;
+    st->lead = lead;
+    st->trail = trail;
+    st->window = true;
+    return bw_put(bw, 0x3, 2) && bw_put(bw, lead, 5) && bw_put(bw, len - 1, 5) &&
+           bw_put(bw, x >> trail, len);
+}
+
+static bool get_xor(bit_reader *br, xor_state *st, float *value)
+{
+    uint64_t bit, field, len;
+
+    if (!br_get(br, 1, &bit))
+        return false;
+    if (bit == 0)
+    {
+        *value = bits_float(st->prev);
+        return true;
+    }
+
+    if (!br_get(br, 1, &bit))
+        return false;
+    if (bit == 1)
+    {
+        if (!br_get(br, 5, &field) || !br_get(br, 5, &len))
+            return false;
+        st->lead = (unsigned)field;
+        st->trail = 32 - st->lead - (unsigned)(len + 1);
+        st->window = true;
+    }
+    else if (!st->window)
+    {
+        return false;
+    }
+
+    if (!br_get(br, 32 - st->lead - st->trail, &field))
+        return false;
+    st->prev ^= (uint32_t)field << st->trail;
+    *value = bits_float(st->prev);
+    return true;
+}
+
+/// @brief перевод последних значений HWT905 в отсчет архива
+/// @param sample отсчет архива
+/// @param values значения, полученные от устройства
+/// @param ts_us время отсчета, микросекунды UTC
+void archive_sample_from_values(archive_sample *sample, const hwt905_values *values, uint64_t ts_us)
+{
+    sample->ts_us = ts_us;
+
+    sample->i16[0] = (int16_t)values->magneta[0];
+    sample->i16[1] = (int16_t)values->magneta[1];
+    sample->i16[2] = (int16_t)values->magneta[2];
+    sample->i16[3] = (int16_t)(values->temperature * 100.);
+    sample->i16[4] = (int16_t)values->version;
+
+    for (int i = 0; i < 3; i++)
+    {
+        sample->f32[i] = (float)values->acceleration[i];
+        sample->f32[3 + i] = (float)values->angularVelocity[i];
+        sample->f32[6 + i] = values->angle[i];
+    }
+    for (int i = 0; i < 4; i++)
+        sample->f32[9 + i] = (float)values->quaterion[i];
+}
+
+/// @brief кодирование блока отсчетов. Первый отсчет времени хранится в заголовке блока,
+/// остальные - delta-of-delta. Каналы int16 - разность + zigzag varint, float - XOR.
+/// Каждый блок декодируется независимо
+/// @param samples отсчеты
+/// @param count количество отсчетов
+/// @param out буфер для результата
+/// @param out_len размер буфера
+/// @return количество записанных байт или 0, если буфера не хватило
+size_t archive_chunk_encode(const archive_sample *samples, size_t count, uint8_t *out, size_t out_len)
+{
+    bit_writer bw = {out, out_len, 0};
+    int16_t prev_i16[ARCHIVE_I16_CHANNELS] = {0};
+    xor_state xs[ARCHIVE_F32_CHANNELS];
+    uint64_t prev_ts = count > 0 ? samples[0].ts_us : 0;
+    int64_t prev_delta = 0;
+
+    memset(xs, 0, sizeof(xs));
+
+    for (size_t n = 0; n < count; n++)
+    {
+        const archive_sample *s = &samples[n];
+        int64_t delta = (int64_t)(s->ts_us - prev_ts);
+
+        if (!put_dod(&bw, delta - prev_delta))
+            return 0;
+        prev_delta = delta;
+        prev_ts = s->ts_us;
+
+        for (int c = 0; c < ARCHIVE_I16_CHANNELS; c++)
+        {
+            if (!put_varint(&bw, zigzag32((int32_t)s->i16[c] - prev_i16[c])))
+                return 0;
+            prev_i16[c] = s->i16[c];
+        }
+
+        for (int c = 0; c < ARCHIVE_F32_CHANNELS; c++)
+        {
+            if (!put_xor(&bw, &xs[c], s->f32[c]))
+                return 0;
+        }
+    }
+    return (bw.bit + 7) / 8;
+}
+
+/// @brief декодирование блока, обратное archive_chunk_encode
+/// @return true в случае успеха
+bool archive_chunk_decode(const uint8_t *data, size_t len, uint64_t first_ts, archive_sample *samples, size_t count)
+{
+    bit_reader br = {data, len, 0};
+    int16_t prev_i16[ARCHIVE_I16_CHANNELS] = {0};
+    xor_state xs[ARCHIVE_F32_CHANNELS];
+    uint64_t prev_ts = first_ts;
+    int64_t prev_delta = 0;
+
+    memset(xs, 0, sizeof(xs));
+
+    for (size_t n = 0; n < count; n++)
+    {
+        archive_sample *s = &samples[n];
+        int64_t dod;
+
+        if (!get_dod(&br, &dod))
+            return false;
+        prev_delta += dod;
+        prev_ts += prev_delta;
+        s->ts_us = prev_ts;
+
+        for (int c = 0; c < ARCHIVE_I16_CHANNELS; c++)
+        {
+            uint32_t z;
+            if (!get_varint(&br, &z))
+                return false;
+            prev_i16[c] = (int16_t)(prev_i16[c] + unzigzag32(z));
+            s->i16[c] = prev_i16[c];
+        }
+
+        for (int c = 0; c < ARCHIVE_F32_CHANNELS; c++)
+        {
+            if (!get_xor(&br, &xs[c], &s->f32[c]))
+                return false;
+        }
+    }
+    return true;
+}
+
+static bool write_full(int fd, const void *data, size_t len)
+{
+    const uint8_t *p = data;
+    while (len > 0)
+    {
+        ssize_t n = write(fd, p, len);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return false;
+        }
+        p += n;
+        len -= (size_t)n;
+    }
+    return true;
+}
+
+static bool read_full(int fd, void *data, size_t len)
+{
+    uint8_t *p = data;
+    while (len > 0)
+    {
+        ssize_t n = read(fd, p, len);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+        p += n;
+        len -= (size_t)n;
+    }
+    return true;
+}
+
+static void close_files(archive_writer *writer)
+{
+    if (writer->data_fd >= 0)
+        close(writer->data_fd);
+    if (writer->index_fd >= 0)
+        close(writer->index_fd);
+    writer->data_fd = -1;
+    writer->index_fd = -1;
+}
+
+
+/// @brief заголовок блока и запись индекса хранятся в файле little-endian независимо от платформы
+static void chunk_header_to_le(archive_chunk_header *header)
+{
+    header->magic = htole32(header->magic);
+    header->version = htole16(header->version);
+    header->count = htole16(header->count);
+    header->first_ts = htole64(header->first_ts);
+    header->last_ts = htole64(header->last_ts);
+    header->payload_bytes = htole32(header->payload_bytes);
+}
+
+static void chunk_header_from_le(archive_chunk_header *header)
+{
+    header->magic = le32toh(header->magic);
+    header->version = le16toh(header->version);
+    header->count = le16toh(header->count);
+    header->first_ts = le64toh(header->first_ts);
+    header->last_ts = le64toh(header->last_ts);
+    header->payload_bytes = le32toh(header->payload_bytes);
+}
+
+static void index_entry_to_le(archive_index_entry *entry)
+{
+    entry->first_ts = htole64(entry->first_ts);
+    entry->last_ts = htole64(entry->last_ts);
+    entry->offset = htole64(entry->offset);
+    entry->count = htole32(entry->count);
+    entry->payload_bytes = htole32(entry->payload_bytes);
+}
+
+static void index_entry_from_le(archive_index_entry *entry)
+{
+    entry->first_ts = le64toh(entry->first_ts);
+    entry->last_ts = le64toh(entry->last_ts);
+    entry->offset = le64toh(entry->offset);
+    entry->count = le32toh(entry->count);
+    entry->payload_bytes = le32toh(entry->payload_bytes);
+}
+
+/// @brief открытие файлов архива для часа hour. Существующие файлы дописываются
+static bool open_hour(archive_writer *writer, uint64_t hour)
+{
+    char path[ARCHIVE_PATH_LEN + 64];
+    char index_path[ARCHIVE_PATH_LEN + 72];
+    time_t t = (time_t)(hour * 3600);
+    struct tm tm;
+    struct stat st;
+
+    gmtime_r(&t, &tm);
+    snprintf(path, sizeof(path), "%s/hwt905_%04d%02d%02d_%02d.hwa", writer->dir,
+             tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday, tm.tm_hour);
+    snprintf(index_path, sizeof(index_path), "%s.idx", path);
+
+    writer->data_fd = open(path, O_WRONLY | O_CREAT | O_APPEND, 0644);
+    if (writer->data_fd < 0)
+    {
+        perror("Ошибка открытия файла архива");
+        return false;
+    }
+    writer->index_fd = open(index_path, O_WRONLY | O_CREAT | O_APPEND, 0644);
+    if (writer->index_fd < 0)
+    {
+        perror("Ошибка открытия индекса архива");
+        close_files(writer);
+        return false;
+    }
+
+    if (fstat(writer->data_fd, &st) != 0)
+    {
+        close_files(writer);
+        return false;
+    }
+    writer->data_offset = (uint64_t)st.st_size;
+
+    if (writer->data_offset == 0)
+    {
+        uint32_t header[2] = {htole32(ARCHIVE_FILE_MAGIC), htole32(ARCHIVE_VERSION)};
+        if (!write_full(writer->data_fd, header, sizeof(header)))
+        {
+            close_files(writer);
+            return false;
+        }
+        writer->data_offset = sizeof(header);
+    }
+    writer->hour = hour;
+    return true;
+}
+
+/// @brief открыть архив в каталоге dir
+/// @param writer состояние записи
+/// @param dir каталог архива
+/// @param chunk_buffer буфер блока размером ARCHIVE_CHUNK_MAX_BYTES, если NULL - выделяется malloc
+/// @param pending накапливаемый блок на ARCHIVE_CHUNK_SAMPLES отсчетов, если NULL - выделяется malloc
+/// @return true в случае успеха
+bool archive_writer_open(archive_writer *writer, const char *dir, uint8_t *chunk_buffer, archive_sample *pending)
+{
+    memset(writer, 0, sizeof(*writer));
+    writer->data_fd = -1;
+    writer->index_fd = -1;
+    snprintf(writer->dir, sizeof(writer->dir), "%s", dir);
+
+    writer->chunk_buffer = chunk_buffer;
+    if (writer->chunk_buffer == NULL)
+        writer->chunk_buffer = (uint8_t*) malloc(ARCHIVE_CHUNK_MAX_BYTES);
+    writer->pending = pending;
+    if (writer->pending == NULL)
+        writer->pending = (archive_sample*) malloc(ARCHIVE_CHUNK_SAMPLES * sizeof(archive_sample));
+    if (writer->chunk_buffer == NULL || writer->pending == NULL)
+    {
+        printf("Error %i from malloc: %s\n", errno, strerror(errno));
+        return false;
+    }
+    return true;
+}
+
+/// @brief записать накопленный блок и запись индекса на диск
+/// @return true в случае успеха
+bool archive_writer_flush(archive_writer *writer)
+{
+    if (writer->pending_count == 0)
+        return true;
+
+    size_t count = writer->pending_count;
+    writer->pending_count = 0;
+
+    if (writer->data_fd < 0 && !open_hour(writer, writer->pending[0].ts_us / US_PER_HOUR))
+        return false;
+
+    size_t payload = archive_chunk_encode(writer->pending, count, writer->chunk_buffer, ARCHIVE_CHUNK_MAX_BYTES);
+    if (payload == 0)
+    {
+        printf("Ошибка кодирования блока архива\n");
+        return false;
+    }
+
+    archive_chunk_header header = {
+        .magic = ARCHIVE_CHUNK_MAGIC,
+        .version = ARCHIVE_VERSION,
+        .count = (uint16_t)count,
+        .first_ts = writer->pending[0].ts_us,
+        .last_ts = writer->pending[count - 1].ts_us,
+        .payload_bytes = (uint32_t)payload
+    };
+    archive_index_entry entry = {
+        .first_ts = header.first_ts,
+        .last_ts = header.last_ts,
+        .offset = writer->data_offset,
+        .count = header.count,
+        .payload_bytes = header.payload_bytes
+    };
+
+    chunk_header_to_le(&header);
+    index_entry_to_le(&entry);
+    if (!write_full(writer->data_fd, &header, sizeof(header)) ||
+        !write_full(writer->data_fd, writer->chunk_buffer, payload) ||
+        !write_full(writer->index_fd, &entry, sizeof(entry)))
+    {
+        perror("Ошибка записи архива");
+        return false;
+    }
+
+    writer->data_offset += sizeof(header) + payload;
+    writer->samples_written += count;
+    writer->bytes_written += sizeof(header) + payload;
+    return true;
+}
+
+/// @brief добавить отсчет в архив. Блок пишется на диск по заполнении,
+/// при смене часа или при разрыве во времени, который не помещается в delta-of-delta
+/// @return true в случае успеха
+bool archive_write(archive_writer *writer, const archive_sample *sample)
+{
+    uint64_t hour = sample->ts_us / US_PER_HOUR;
+
+    if (writer->pending_count > 0)
+    {
+        const archive_sample *last = &writer->pending[writer->pending_count - 1];
+        bool gap = sample->ts_us < last->ts_us || sample->ts_us - last->ts_us > INT32_MAX / 2;
+
+        if (gap || hour != last->ts_us / US_PER_HOUR)
+        {
+            if (!archive_writer_flush(writer))
+                return false;
+        }
+    }
+
+    if (writer->data_fd >= 0 && hour != writer->hour)
+        close_files(writer);
+
+    writer->pending[writer->pending_count++] = *sample;
+    if (writer->pending_count == ARCHIVE_CHUNK_SAMPLES)
+        return archive_writer_flush(writer);
+    return true;
+}
+
+/// @brief записать остаток данных и закрыть файлы архива
+void archive_writer_close(archive_writer *writer)
+{
+    archive_writer_flush(writer);
+    close_files(writer);
+}
+
+/// @brief построение индекса проходом по файлу, если файла .idx нет
+static bool scan_index(archive_reader *reader)
+{
+    archive_chunk_header header;
+    size_t capacity = 0;
+    off_t offset = 2 * sizeof(uint32_t);
+
+    while (lseek(reader->data_fd, offset, SEEK_SET) == offset &&
+           read_full(reader->data_fd, &header, sizeof(header)))
+    {
+        chunk_header_from_le(&header);
+        if (header.magic != ARCHIVE_CHUNK_MAGIC)
+            return false;
+
+        if (reader->index_count == capacity)
+        {
+            capacity = capacity ? capacity * 2 : 64;
+            archive_index_entry *grown = realloc(reader->index, capacity * sizeof(*grown));
+            if (grown == NULL)
+                return false;
+            reader->index = grown;
+        }
+        reader->index[reader->index_count++] = (archive_index_entry) {
+            header.first_ts, header.last_ts, (uint64_t)offset, header.count, header.payload_bytes
+        };
+        offset += sizeof(header) + header.payload_bytes;
+    }
+    return true;
+}
+
+/// @brief открыть файл архива для чтения. Индекс берется из <path>.idx или строится по файлу
+/// @return true в случае успеха
+bool archive_reader_open(archive_reader *reader, const char *path)
+{
+    char index_path[ARCHIVE_PATH_LEN + 8];
+    uint32_t header[2];
+    struct stat st;
+
+    memset(reader, 0, sizeof(*reader));
+    reader->data_fd = open(path, O_RDONLY);
+    if (reader->data_fd < 0)
+    {
+        perror("Ошибка открытия файла архива");
+        return false;
+    }
+    if (!read_full(reader->data_fd, header, sizeof(header)) || le32toh(header[0]) != ARCHIVE_FILE_MAGIC)
+    {
+        printf("Файл %s не является архивом HWT905\n", path);
+        archive_reader_close(reader);
+        return false;
+    }
+
+    reader->chunk_buffer = (uint8_t*) malloc(ARCHIVE_CHUNK_MAX_BYTES);
+    if (reader->chunk_buffer == NULL)
+    {
+        archive_reader_close(reader);
+        return false;
+    }
+
+    snprintf(index_path, sizeof(index_path), "%s.idx", path);
+    int index_fd = open(index_path, O_RDONLY);
+    if (index_fd >= 0 && fstat(index_fd, &st) == 0 && st.st_size > 0)
+    {
+        reader->index_count = (size_t)st.st_size / sizeof(archive_index_entry);
+        reader->index = malloc(reader->index_count * sizeof(archive_index_entry));
+        if (reader->index == NULL ||
+            !read_full(index_fd, reader->index, reader->index_count * sizeof(archive_index_entry)))
+        {
+            close(index_fd);
+            archive_reader_close(reader);
+            return false;
+        }
+        for (size_t i = 0; i < reader->index_count; i++)
+            index_entry_from_le(&reader->index[i]);
+    }
+    else if (!scan_index(reader))
+    {
+        if (index_fd >= 0)
+            close(index_fd);
+        archive_reader_close(reader);
+        return false;
+    }
+    if (index_fd >= 0)
+        close(index_fd);
+    return true;
+}
+
+/// @brief перейти к первому блоку, содержащему отсчеты не раньше ts_us (двоичный поиск по индексу)
+/// @return false, если таких отсчетов нет
+bool archive_reader_seek(archive_reader *reader, uint64_t ts_us)
+{
+    size_t lo = 0, hi = reader->index_count;
+
+    while (lo < hi)
+    {
+        size_t mid = lo + (hi - lo) / 2;
+        if (reader->index[mid].last_ts < ts_us)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    reader->chunk = lo;
+    reader->sample_count = 0;
+    reader->sample_pos = 0;
+
+    archive_sample sample;
+    while (archive_reader_next(reader, &sample))
+    {
+        if (sample.ts_us >= ts_us)
+        {
+            reader->sample_pos--;
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool load_chunk(archive_reader *reader)
+{
+    const archive_index_entry *entry = &reader->index[reader->chunk++];
+    archive_chunk_header header;
+
+    if (entry->count > ARCHIVE_CHUNK_SAMPLES || entry->payload_bytes > ARCHIVE_CHUNK_MAX_BYTES)
+        return false;
+    if (lseek(reader->data_fd, (off_t)entry->offset, SEEK_SET) != (off_t)entry->offset ||
+        !read_full(reader->data_fd, &header, sizeof(header)))
+        return false;
+    chunk_header_from_le(&header);
+    if (header.magic != ARCHIVE_CHUNK_MAGIC)
+        return false;
+
+    // заголовок блока должен совпадать с индексом: иначе файл обрезан или поврежден,
+    // и размеры из заголовка нельзя использовать для чтения в буферы фиксированного размера
+    if (header.count > ARCHIVE_CHUNK_SAMPLES || header.payload_bytes > ARCHIVE_CHUNK_MAX_BYTES ||
+        header.count != entry->count || header.payload_bytes != entry->payload_bytes ||
+        header.first_ts != entry->first_ts || header.last_ts != entry->last_ts)
+    {
+        printf("Архив: блок %zu поврежден (заголовок не совпадает с индексом)\n", reader->chunk - 1);
+        return false;
+    }
+    if (!read_full(reader->data_fd, reader->chunk_buffer, header.payload_bytes))
+        return false;
+
+    if (!archive_chunk_decode(reader->chunk_buffer, header.payload_bytes, header.first_ts,
+                              reader->samples, header.count))
+        return false;
+
+    reader->sample_count = header.count;
+    reader->sample_pos = 0;
+    return true;
+}
+
+/// @brief прочитать следующий отсчет
+/// @return false в конце архива или при ошибке
+bool archive_reader_next(archive_reader *reader, archive_sample *sample)
+{
+    while (reader->sample_pos >= reader->sample_count)
+    {
+        if (reader->chunk >= reader->index_count || !load_chunk(reader))
+            return false;
+    }
+    *sample = reader->samples[reader->sample_pos++];
+    return true;
+}
+
+void archive_reader_close(archive_reader *reader)
+{
+    if (reader->data_fd >= 0)
+        close(reader->data_fd);
+    free(reader->index);
+    free(reader->chunk_buffer);
+    reader->data_fd = -1;
+    reader->index = NULL;
+    reader->chunk_buffer = NULL;
+}
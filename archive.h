@@ -0,0 +1,98 @@
+#ifndef ARCHIVE_H
+#define ARCHIVE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#include "hwt905.h"
+
+#define ARCHIVE_FILE_MAGIC 0x31415748u   // "HWA1"
+#define ARCHIVE_CHUNK_MAGIC 0x43415748u  // "HWAC"
+#define ARCHIVE_VERSION 1
+
+#define ARCHIVE_I16_CHANNELS 5   // магнитное поле x,y,z, температура (сотые градуса), версия
+#define ARCHIVE_F32_CHANNELS 13  // ускорение x,y,z, угловая скорость x,y,z, угол x,y,z, кватернион 0..3
+
+#define ARCHIVE_CHUNK_SAMPLES 512
+// худший случай на один отсчет: 36 бит времени + 5 * 24 бита int16 + 13 * 45 бит float
+#define ARCHIVE_SAMPLE_MAX_BYTES 93
+#define ARCHIVE_CHUNK_MAX_BYTES (ARCHIVE_CHUNK_SAMPLES * ARCHIVE_SAMPLE_MAX_BYTES + 16)
+
+#define ARCHIVE_PATH_LEN 512
+
+/// @brief один отсчет архива: время в микросекундах (UTC) и каналы
+typedef struct
+{
+    uint64_t ts_us;
+    int16_t i16[ARCHIVE_I16_CHANNELS];
+    float f32[ARCHIVE_F32_CHANNELS];
+} archive_sample;
+
+/// @brief заголовок блока (chunk) в файле архива. Все поля little-endian, переводятся при записи и чтении.
+/// Файл начинается с двух uint32 little-endian: ARCHIVE_FILE_MAGIC и ARCHIVE_VERSION
+typedef struct __attribute__((packed))
+{
+    uint32_t magic;
+    uint16_t version;
+    uint16_t count;
+    uint64_t first_ts;
+    uint64_t last_ts;
+    uint32_t payload_bytes;
+} archive_chunk_header;
+
+/// @brief запись индекса блоков (файл <архив>.idx), по ней выполняется поиск по времени. Все поля little-endian
+typedef struct __attribute__((packed))
+{
+    uint64_t first_ts;
+    uint64_t last_ts;
+    uint64_t offset;
+    uint32_t count;
+    uint32_t payload_bytes;
+} archive_index_entry;
+
+/// @brief состояние записи архива. Файлы ротируются каждый час:
+/// <dir>/hwt905_YYYYMMDD_HH.hwa и индекс <dir>/hwt905_YYYYMMDD_HH.hwa.idx
+typedef struct
+{
+    char dir[ARCHIVE_PATH_LEN];
+    int data_fd;
+    int index_fd;
+    uint64_t hour;              // номер текущего часа (ts_us / 3600e6)
+    uint64_t data_offset;       // текущий размер файла данных
+    archive_sample *pending;    // ARCHIVE_CHUNK_SAMPLES отсчетов
+    size_t pending_count;
+    uint8_t *chunk_buffer;      // ARCHIVE_CHUNK_MAX_BYTES байт
+    uint64_t samples_written;
+    uint64_t bytes_written;
+} archive_writer;
+
+/// @brief состояние чтения архива
+typedef struct
+{
+    int data_fd;
+    archive_index_entry *index;
+    size_t index_count;
+    size_t chunk;               // номер следующего блока для чтения
+    archive_sample samples[ARCHIVE_CHUNK_SAMPLES];
+    size_t sample_count;
+    size_t sample_pos;
+    uint8_t *chunk_buffer;
+} archive_reader;
+
+void archive_sample_from_values(archive_sample *sample, const hwt905_values *values, uint64_t ts_us);
+
+size_t archive_chunk_encode(const archive_sample *samples, size_t count, uint8_t *out, size_t out_len);
+bool archive_chunk_decode(const uint8_t *data, size_t len, uint64_t first_ts, archive_sample *samples, size_t count);
+
+bool archive_writer_open(archive_writer *writer, const char *dir, uint8_t *chunk_buffer, archive_sample *pending);
+bool archive_write(archive_writer *writer, const archive_sample *sample);
+bool archive_writer_flush(archive_writer *writer);
+void archive_writer_close(archive_writer *writer);
+
+bool archive_reader_open(archive_reader *reader, const char *path);
+bool archive_reader_seek(archive_reader *reader, uint64_t ts_us);
+bool archive_reader_next(archive_reader *reader, archive_sample *sample);
+void archive_reader_close(archive_reader *reader);
+
+#endif // ARCHIVE_H
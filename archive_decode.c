@@ -0,0 +1,142 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+
+#include "archive.h"
+
+// Утилита для чтения архива HWT905.
+// archive_decode [-f от_мкс] [-t до_мкс] файл.hwa - вывод отсчетов в CSV
+// archive_decode -b файл.hwa - степень сжатия и скорость кодирования на записанных данных
+
+static void usage(const char *name)
+{
+    printf("Использование: %s [-f from_us] [-t to_us] [-b] file.hwa\n", name);
+}
+
+static double now_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void print_sample(const archive_sample *s)
+{
+    printf("%llu", (unsigned long long)s->ts_us);
+    for (int c = 0; c < ARCHIVE_F32_CHANNELS; c++)
+        printf(",%f", s->f32[c]);
+    for (int c = 0; c < ARCHIVE_I16_CHANNELS; c++)
+        printf(",%i", s->i16[c]);
+    printf("\n");
+}
+
+/// @brief повторное кодирование всех отсчетов файла в памяти и замер скорости
+static int benchmark(archive_reader *reader)
+{
+    size_t capacity = 1 << 16, count = 0;
+    archive_sample *samples = malloc(capacity * sizeof(*samples));
+    uint8_t *out = malloc(ARCHIVE_CHUNK_MAX_BYTES);
+    archive_sample sample;
+
+    if (samples == NULL || out == NULL)
+        return 1;
+
+    while (archive_reader_next(reader, &sample))
+    {
+        if (count == capacity)
+        {
+            capacity *= 2;
+            archive_sample *grown = realloc(samples, capacity * sizeof(*samples));
+            if (grown == NULL)
+                return 1;
+            samples = grown;
+        }
+        samples[count++] = sample;
+    }
+    if (count == 0)
+    {
+        printf("Архив пуст\n");
+        return 1;
+    }
+
+    size_t encoded = 0;
+    size_t rounds = 0;
+    double start = now_seconds(), elapsed;
+    do
+    {
+        encoded = 0;
+        for (size_t i = 0; i < count; i += ARCHIVE_CHUNK_SAMPLES)
+        {
+            size_t n = count - i < ARCHIVE_CHUNK_SAMPLES ? count - i : ARCHIVE_CHUNK_SAMPLES;
+            encoded += archive_chunk_encode(&samples[i], n, out, ARCHIVE_CHUNK_MAX_BYTES) + sizeof(archive_chunk_header);
+        }
+        rounds++;
+        elapsed = now_seconds() - start;
+    } while (elapsed < 1.0);
+
+    double raw = (double)count * sizeof(hwt905_values);
+    printf("отсчетов: %zu\n", count);
+    printf("hwt905_values: %.0f байт, архив: %zu байт (%.2f байт/отсчет)\n", raw, encoded, (double)encoded / count);
+    printf("степень сжатия: %.2f\n", raw / encoded);
+    printf("скорость кодирования: %.1f МБ/с (по hwt905_values), %.0f отсчетов/с\n",
+           raw * rounds / elapsed / 1e6, (double)count * rounds / elapsed);
+
+    free(samples);
+    free(out);
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    uint64_t from = 0, to = UINT64_MAX;
+    bool bench = false;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "f:t:b")) != -1)
+    {
+        switch (opt)
+        {
+        case 'f':
+            from = strtoull(optarg, NULL, 10);
+            break;
+        case 't':
+            to = strtoull(optarg, NULL, 10);
+            break;
+        case 'b':
+            bench = true;
+            break;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (optind >= argc)
+    {
+        usage(argv[0]);
+        return 1;
+    }
+
+    archive_reader reader;
+    if (!archive_reader_open(&reader, argv[optind]))
+        return 1;
+
+    if (bench)
+    {
+        int result = benchmark(&reader);
+        archive_reader_close(&reader);
+        return result;
+    }
+
+    printf("ts_us,ax,ay,az,gx,gy,gz,roll,pitch,yaw,q0,q1,q2,q3,hx,hy,hz,temp_c100,version\n");
+    archive_sample sample;
+    if (archive_reader_seek(&reader, from))
+    {
+        while (archive_reader_next(&reader, &sample) && sample.ts_us <= to)
+            print_sample(&sample);
+    }
+
+    archive_reader_close(&reader);
+    return 0;
+}
@@ -0,0 +1,194 @@
+#include "arena.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+
+static volatile bool arena_sealed = false;
+
+static size_t align_up(size_t bytes)
+{
+    return (bytes + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+}
+
+static arena_budget* find_budget(arena *a, const char *name, bool create)
+{
+    for (size_t i = 0; i < a->budget_count; i++)
+    {
+        if (strcmp(a->budget[i].name, name) == 0)
+            return &a->budget[i];
+    }
+    if (!create || a->budget_count == ARENA_MAX_SUBSYSTEMS)
+        return NULL;
+
+    arena_budget *budget = &a->budget[a->budget_count++];
+    memset(budget, 0, sizeof(*budget));
+    budget->name = name;
+    return budget;
+}
+
+/// @brief зарезервировать память подсистеме до arena_commit
+/// @param a арена
+/// @param name имя подсистемы (строка должна жить все время работы)
+/// @param bytes размер, может вызываться несколько раз для одной подсистемы
+void arena_reserve(arena *a, const char *name, size_t bytes)
+{
+    arena_budget *budget = find_budget(a, name, true);
+    if (budget == NULL)
+    {
+        printf("Арена: слишком много подсистем (%s)\n", name);
+        return;
+    }
+    budget->reserved += align_up(bytes);
+}
+
+/// @brief учесть в отчете статическую структуру или стек потока, память под которые выделена не из арены
+void arena_account_static(arena *a, const char *name, size_t bytes)
+{
+    arena_budget *budget = find_budget(a, name, true);
+    if (budget == NULL)
+        return;
+    budget->reserved += bytes;
+    budget->used += bytes;
+    budget->is_static = true;
+}
+
+/// @brief выделить одну область под все резервы и заранее затронуть ее страницы
+/// @return true в случае успеха
+bool arena_commit(arena *a)
+{
+    a->size = 0;
+    for (size_t i = 0; i < a->budget_count; i++)
+    {
+        if (!a->budget[i].is_static)
+            a->size += a->budget[i].reserved;
+    }
+    a->offset = 0;
+    if (a->size == 0)
+        return true;
+
+    a->base = (uint8_t*) aligned_alloc(ARENA_ALIGN, a->size);
+    if (a->base == NULL)
+    {
+        printf("Error %i from aligned_alloc: %s\n", errno, strerror(errno));
+        return false;
+    }
+    memset(a->base, 0, a->size);
+    return true;
+}
+
+/// @brief выделить память подсистеме из ее резерва
+/// @param a арена
+/// @param name имя подсистемы, под которым делался arena_reserve
+/// @param bytes размер
+/// @return указатель, выровненный на ARENA_ALIGN, или NULL, если резерв исчерпан
+void* arena_alloc(arena *a, const char *name, size_t bytes)
+{
+    arena_budget *budget = find_budget(a, name, false);
+    size_t aligned = align_up(bytes);
+
+    if (budget == NULL || budget->is_static || budget->used + aligned > budget->reserved ||
+        a->offset + aligned > a->size)
+    {
+        printf("Арена: нет резерва для %s (%zu байт)\n", name, bytes);
+        return NULL;
+    }
+
+    void *ptr = a->base + a->offset;
+    a->offset += aligned;
+    budget->used += aligned;
+    return ptr;
+}
+
+/// @brief имя подсистемы с выравниванием по ширине в символах (имена в UTF-8)
+static void print_name(const char *name)
+{
+    int chars = 0;
+    for (const char *c = name; *c != '\0'; c++)
+    {
+        if ((*c & 0xC0) != 0x80)
+            chars++;
+    }
+    printf("  %s%*s", name, chars < 20 ? 20 - chars : 0, "");
+}
+
+/// @brief отчет о бюджете памяти по подсистемам
+void arena_report(const arena *a)
+{
+    size_t static_total = 0;
+
+    printf("Бюджет памяти (арена %zu байт, выделено %zu):\n", a->size, a->offset);
+    for (size_t i = 0; i < a->budget_count; i++)
+    {
+        const arena_budget *budget = &a->budget[i];
+        print_name(budget->name);
+        if (budget->is_static)
+        {
+            printf(" %10zu байт (вне арены)\n", budget->used);
+            static_total += budget->used;
+        }
+        else
+        {
+            printf(" %10zu / %zu байт\n", budget->used, budget->reserved);
+        }
+    }
+    print_name("всего");
+    printf(" %10zu байт\n", a->size + static_total);
+}
+
+/// @brief запретить выделения из кучи до завершения программы
+void arena_seal(void)
+{
+    arena_sealed = true;
+}
+
+void arena_free(arena *a)
+{
+    free(a->base);
+    a->base = NULL;
+    a->size = 0;
+    a->offset = 0;
+}
+
+#ifdef HWT905_ARENA_DEBUG
+// Отладочный контроль: сборка с -DHWT905_ARENA_DEBUG -Wl,--wrap=malloc,--wrap=calloc,--wrap=realloc
+// подменяет вызовы из кода программы. Выделение после arena_seal завершает процесс с сообщением
+
+void* __real_malloc(size_t size);
+void* __real_calloc(size_t count, size_t size);
+void* __real_realloc(void *ptr, size_t size);
+
+static void heap_violation(const char *function)
+{
+    // printf здесь нельзя: он сам может выделять память
+    char message[96] = "Арена: выделение из кучи после инициализации: ";
+    strncat(message, function, sizeof(message) - strlen(message) - 2);
+    strcat(message, "\n");
+    ssize_t written = write(STDERR_FILENO, message, strlen(message));
+    (void) written;
+    abort();
+}
+
+void* __wrap_malloc(size_t size)
+{
+    if (arena_sealed)
+        heap_violation("malloc");
+    return __real_malloc(size);
+}
+
+void* __wrap_calloc(size_t count, size_t size)
+{
+    if (arena_sealed)
+        heap_violation("calloc");
+    return __real_calloc(count, size);
+}
+
+void* __wrap_realloc(void *ptr, size_t size)
+{
+    if (arena_sealed)
+        heap_violation("realloc");
+    return __real_realloc(ptr, size);
+}
+#endif
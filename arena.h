@@ -0,0 +1,41 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#define ARENA_ALIGN 64          // выравнивание выделений по строке кэша
+#define ARENA_MAX_SUBSYSTEMS 24
+
+/// @brief строка бюджета памяти: сколько подсистеме зарезервировано и сколько она получила.
+/// Статические структуры (глобальные переменные) и стеки потоков учитываются только для отчета
+typedef struct
+{
+    const char *name;
+    size_t reserved;
+    size_t used;
+    bool is_static;
+} arena_budget;
+
+/// @brief арена: одна область памяти, выделяемая при запуске. Порядок работы:
+/// arena_reserve для каждой подсистемы -> arena_commit -> arena_alloc -> arena_seal.
+/// После arena_seal выделения из кучи запрещены (проверяется при сборке с HWT905_ARENA_DEBUG)
+typedef struct
+{
+    uint8_t *base;
+    size_t size;
+    size_t offset;
+    arena_budget budget[ARENA_MAX_SUBSYSTEMS];
+    size_t budget_count;
+} arena;
+
+void arena_reserve(arena *a, const char *name, size_t bytes);
+void arena_account_static(arena *a, const char *name, size_t bytes);
+bool arena_commit(arena *a);
+void* arena_alloc(arena *a, const char *name, size_t bytes);
+void arena_report(const arena *a);
+void arena_seal(void);
+void arena_free(arena *a);
+
+#endif // ARENA_H
@@ -0,0 +1,174 @@
+#include "clock_align.h"
+
+#include <string.h>
+#include <time.h>
+#include <math.h>
+
+static uint64_t monotonic_now(void);
+static uint64_t realtime_now(void);
+
+void clock_align_init(clock_align *ca)
+{
+    memset(ca, 0, sizeof(*ca));
+    ca->realtime_offset_us = (int64_t)(realtime_now() - monotonic_now());
+}
+
+/// @brief время устройства из кадра TIME в миллисекундах от 1970-01-01 (часы устройства считаются UTC)
+uint64_t hwt905_device_time_ms(const hwt905_values *values)
+{
+    struct tm tm = {0};
+
+    tm.tm_year = values->YY + 100;
+    tm.tm_mon = values->MM > 0 ? values->MM - 1 : 0;
+    tm.tm_mday = values->DD > 0 ? values->DD : 1;
+    tm.tm_hour = values->hh;
+    tm.tm_min = values->mm;
+    tm.tm_sec = values->ss;
+    return (uint64_t)timegm(&tm) * 1000 + values->ms;
+}
+
+static void reset(clock_align *ca, uint64_t device_ms, uint64_t host_us)
+{
+    uint64_t resets = ca->valid ? ca->resets + 1 : ca->resets;
+
+    clock_align_init(ca);
+    ca->valid = true;
+    ca->resets = resets;
+    ca->device0_ms = device_ms;
+    ca->host0_us = host_us;
+}
+
+static uint64_t monotonic_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static uint64_t realtime_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/// @brief пересчет смещения и ухода по точкам минимальной задержки
+static void fit(clock_align *ca)
+{
+    double n = 0, sx = 0, sd = 0, sxx = 0, sxd = 0;
+
+    for (size_t i = 0; i <= ca->window_count; i++)
+    {
+        const clock_align_point *p = i < ca->window_count ? &ca->windows[i] : &ca->current;
+        n += 1;
+        sx += p->x;
+        sd += p->d;
+        sxx += p->x * p->x;
+        sxd += p->x * p->d;
+    }
+
+    double det = n * sxx - sx * sx;
+    double drift = 0.;
+    if (ca->window_count >= 2 && det > 0.)
+    {
+        drift = (n * sxd - sx * sd) / det;
+        if (drift > CLOCK_ALIGN_MAX_DRIFT)
+            drift = CLOCK_ALIGN_MAX_DRIFT;
+        if (drift < -CLOCK_ALIGN_MAX_DRIFT)
+            drift = -CLOCK_ALIGN_MAX_DRIFT;
+    }
+    ca->drift = drift;
+    ca->offset = (sd - drift * sx) / n;
+
+    // прямая не должна проходить выше минимума текущего окна
+    double current = ca->current.d - (ca->offset + drift * ca->current.x);
+    if (current < 0.)
+        ca->offset += current;
+}
+
+/// @brief добавить наблюдение: кадр TIME с временем device_ms пришел в момент host_us
+/// @param ca состояние
+/// @param device_ms время устройства, мс
+/// @param host_us время прихода кадра, монотонные мкс
+void clock_align_update(clock_align *ca, uint64_t device_ms, uint64_t host_us)
+{
+    ca->realtime_offset_us = (int64_t)(realtime_now() - monotonic_now());
+
+    if (!ca->valid || device_ms < ca->device0_ms || host_us < ca->host0_us)
+        reset(ca, device_ms, host_us);
+
+    double x = (double)(device_ms - ca->device0_ms) * 1000.;
+    double d = (double)(host_us - ca->host0_us) - x;
+
+    // часы устройства переставлены или был долгий разрыв - начинаем оценку заново
+    if (ca->samples > 0 && fabs(d - (ca->offset + ca->drift * x)) > CLOCK_ALIGN_RESET_US)
+    {
+        reset(ca, device_ms, host_us);
+        x = 0.;
+        d = 0.;
+    }
+
+    if (ca->samples == 0)
+    {
+        ca->window_start = x;
+        ca->current = (clock_align_point) {x, d};
+    }
+    else if (x - ca->window_start >= CLOCK_ALIGN_WINDOW_US)
+    {
+        ca->windows[ca->window_next] = ca->current;
+        ca->window_next = (ca->window_next + 1) % CLOCK_ALIGN_WINDOWS;
+        if (ca->window_count < CLOCK_ALIGN_WINDOWS)
+            ca->window_count++;
+        ca->window_start = x;
+        ca->current = (clock_align_point) {x, d};
+    }
+    else if (d < ca->current.d)
+    {
+        ca->current = (clock_align_point) {x, d};
+    }
+
+    ca->samples++;
+    fit(ca);
+    ca->last_device_ms = device_ms;
+    ca->last_host_us = host_us;
+}
+
+/// @brief скорректированное время измерения по времени устройства
+/// @param ca состояние
+/// @param device_ms время устройства, мс
+/// @param fallback_us время, возвращаемое, пока оценки нет (обычно время прихода кадра)
+/// @return время измерения, монотонные мкс
+uint64_t clock_align_host_time(const clock_align *ca, uint64_t device_ms, uint64_t fallback_us)
+{
+    if (!ca->valid || ca->samples == 0)
+        return fallback_us;
+
+    double x = ((double)device_ms - (double)ca->device0_ms) * 1000.;
+    return (uint64_t)((double)ca->host0_us + x + ca->offset + ca->drift * x);
+}
+
+/// @brief время измерения кадра, у цикла которого нет своего кадра TIME (TIME выключен в содержимом
+/// или потерян): время устройства продолжается от последнего кадра TIME на прошедшее время хоста.
+/// Если кадров TIME не было дольше CLOCK_ALIGN_WINDOW_US, оценка устарела и возвращается время прихода
+/// @param ca состояние
+/// @param host_us время прихода кадра, монотонные мкс
+/// @return время измерения, монотонные мкс
+uint64_t clock_align_extrapolate(const clock_align *ca, uint64_t host_us)
+{
+    if (!ca->valid || ca->samples == 0 || host_us < ca->last_host_us ||
+        host_us - ca->last_host_us > CLOCK_ALIGN_WINDOW_US)
+        return host_us;
+    return clock_align_host_time(ca, ca->last_device_ms + (host_us - ca->last_host_us) / 1000, host_us);
+}
+
+/// @brief перевод монотонного времени в UTC, микросекунды
+uint64_t clock_align_to_realtime(const clock_align *ca, uint64_t host_us)
+{
+    return (uint64_t)((int64_t)host_us + ca->realtime_offset_us);
+}
+
+/// @brief оценка ухода часов устройства относительно хоста, ppm
+double clock_align_drift_ppm(const clock_align *ca)
+{
+    return ca->drift * 1e6;
+}
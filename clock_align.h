@@ -0,0 +1,55 @@
+#ifndef CLOCK_ALIGN_H
+#define CLOCK_ALIGN_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#include "hwt905.h"
+
+#define CLOCK_ALIGN_WINDOW_US 5000000   // длина окна поиска минимальной задержки
+#define CLOCK_ALIGN_WINDOWS 32          // число окон в оценке ухода часов (~160 с)
+#define CLOCK_ALIGN_MAX_DRIFT 0.0005    // допустимый уход часов устройства, 500 ppm
+#define CLOCK_ALIGN_RESET_US 2000000    // скачок часов устройства, после которого оценка сбрасывается
+
+/// @brief точка минимальной задержки в окне: x - время устройства от начала, d - host - device
+typedef struct
+{
+    double x;
+    double d;
+} clock_align_point;
+
+/// @brief сопоставление часов устройства (кадр TIME, миллисекунды) с монотонными часами хоста.
+/// Задержка доставки кадра всегда положительна, поэтому ближе всего к моменту измерения кадры,
+/// пришедшие с минимальной задержкой. В каждом окне CLOCK_ALIGN_WINDOW_US запоминается точка
+/// с минимальной разностью d = host - device, по последним CLOCK_ALIGN_WINDOWS точкам
+/// методом наименьших квадратов оцениваются смещение и уход: d = offset + drift * x.
+/// Получается нижняя огибающая, которая следует за уходом часов и не зависит от джиттера доставки
+typedef struct
+{
+    bool valid;
+    uint64_t device0_ms;
+    uint64_t host0_us;
+    uint64_t samples;
+    uint64_t resets;
+    clock_align_point windows[CLOCK_ALIGN_WINDOWS];
+    size_t window_count;        // заполненные окна (кольцевой буфер)
+    size_t window_next;
+    double window_start;
+    clock_align_point current;  // минимум текущего окна
+    double offset;
+    double drift;
+    int64_t realtime_offset_us; // CLOCK_REALTIME - CLOCK_MONOTONIC на момент последнего обновления
+    uint64_t last_device_ms;    // последний кадр TIME: время устройства и время прихода
+    uint64_t last_host_us;
+} clock_align;
+
+void clock_align_init(clock_align *ca);
+uint64_t hwt905_device_time_ms(const hwt905_values *values);
+void clock_align_update(clock_align *ca, uint64_t device_ms, uint64_t host_us);
+uint64_t clock_align_host_time(const clock_align *ca, uint64_t device_ms, uint64_t fallback_us);
+uint64_t clock_align_extrapolate(const clock_align *ca, uint64_t host_us);
+uint64_t clock_align_to_realtime(const clock_align *ca, uint64_t host_us);
+double clock_align_drift_ppm(const clock_align *ca);
+
+#endif // CLOCK_ALIGN_H
@@ -0,0 +1,132 @@
+#include "command_queue.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+
+static uint64_t monotonic_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/// @brief инициализация очереди
+/// @param queue очередь
+/// @param pool пул элементов на pool_len команд, если NULL - выделяется malloc на COMMAND_POOL_SIZE
+/// @param pool_len размер пула
+/// @return true в случае успеха
+bool command_queue_init(command_queue *queue, struct command_elem *pool, size_t pool_len)
+{
+    if (pool == NULL)
+    {
+        pool_len = COMMAND_POOL_SIZE;
+        pool = (struct command_elem*) malloc(pool_len * sizeof(struct command_elem));
+        if (pool == NULL)
+        {
+            printf("Error %i from malloc: %s\n", errno, strerror(errno));
+            return false;
+        }
+    }
+
+    TAILQ_INIT(&queue->head);
+    TAILQ_INIT(&queue->free_list);
+    for (size_t i = 0; i < pool_len; i++)
+        TAILQ_INSERT_TAIL(&queue->free_list, &pool[i], entries);
+    pthread_mutex_init(&queue->lock, NULL);
+    queue->last_us = 0;
+    queue->pushed = queue->sent = 0;
+    return true;
+}
+
+/// @brief добавить команду в конец очереди
+/// @param queue очередь
+/// @param command байты команды
+/// @param bytes длина команды, не больше COMMAND_MAX_BYTES
+/// @param delay_us пауза перед командой относительно предыдущей, не меньше COMMAND_SPACING_US
+/// @param ticket номер команды для command_queue_sent, может быть NULL
+/// @return true в случае успеха
+bool command_queue_push(command_queue *queue, const uint8_t *command, size_t bytes, uint64_t delay_us, uint64_t *ticket)
+{
+    if (bytes > COMMAND_MAX_BYTES)
+    {
+        printf("Команда длиннее %d байт\n", COMMAND_MAX_BYTES);
+        return false;
+    }
+
+    if (delay_us < COMMAND_SPACING_US)
+        delay_us = COMMAND_SPACING_US;
+
+    pthread_mutex_lock(&queue->lock);
+    struct command_elem *elem = TAILQ_FIRST(&queue->free_list);
+    if (elem == NULL)
+    {
+        pthread_mutex_unlock(&queue->lock);
+        printf("Очередь команд заполнена\n");
+        return false;
+    }
+    TAILQ_REMOVE(&queue->free_list, elem, entries);
+    memcpy(elem->command, command, bytes);
+    elem->bytes = bytes;
+
+    uint64_t now = monotonic_now();
+    elem->not_before_us = queue->last_us + delay_us > now ? queue->last_us + delay_us : now;
+    queue->last_us = elem->not_before_us;
+    TAILQ_INSERT_TAIL(&queue->head, elem, entries);
+    if (ticket != NULL)
+        *ticket = queue->pushed;
+    queue->pushed++;
+    pthread_mutex_unlock(&queue->lock);
+    return true;
+}
+
+/// @brief отправить в порт все команды, время которых наступило
+/// @param queue очередь
+/// @param serial_port порт устройства
+/// @param now_us текущее время, монотонные мкс
+/// @return количество отправленных команд
+size_t command_queue_run(command_queue *queue, int serial_port, uint64_t now_us)
+{
+    size_t sent = 0;
+
+    pthread_mutex_lock(&queue->lock);
+    while (!TAILQ_EMPTY(&queue->head) && TAILQ_FIRST(&queue->head)->not_before_us <= now_us)
+    {
+        struct command_elem *elem = TAILQ_FIRST(&queue->head);
+
+        if (write(serial_port, elem->command, elem->bytes) != (ssize_t)elem->bytes)
+            printf("command message error\n");
+        TAILQ_REMOVE(&queue->head, elem, entries);
+        TAILQ_INSERT_TAIL(&queue->free_list, elem, entries);
+        queue->sent++;
+        sent++;
+    }
+    pthread_mutex_unlock(&queue->lock);
+    return sent;
+}
+
+/// @brief удалить первую команду очереди без отправки и вернуть элемент в пул
+void command_queue_drop_first(command_queue *queue)
+{
+    pthread_mutex_lock(&queue->lock);
+    struct command_elem *elem = TAILQ_FIRST(&queue->head);
+    if (elem != NULL)
+    {
+        TAILQ_REMOVE(&queue->head, elem, entries);
+        TAILQ_INSERT_TAIL(&queue->free_list, elem, entries);
+        queue->sent++;
+    }
+    pthread_mutex_unlock(&queue->lock);
+}
+
+/// @brief количество команд, ушедших из очереди: команда с номером ticket отправлена, если ticket < результата
+uint64_t command_queue_sent(command_queue *queue)
+{
+    pthread_mutex_lock(&queue->lock);
+    uint64_t sent = queue->sent;
+    pthread_mutex_unlock(&queue->lock);
+    return sent;
+}
@@ -0,0 +1,43 @@
+#ifndef COMMAND_QUEUE_H
+#define COMMAND_QUEUE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <sys/queue.h>
+
+#define COMMAND_SPACING_US 100000  // пауза между командами устройству
+#define COMMAND_MAX_BYTES 16       // команды HWT905 - 5 байт
+#define COMMAND_POOL_SIZE 32       // элементов в пуле очереди
+
+struct command_elem
+{
+    uint8_t command[COMMAND_MAX_BYTES];
+    size_t bytes;
+    uint64_t not_before_us;  // команда отправляется не раньше этого времени (монотонные мкс)
+    TAILQ_ENTRY(command_elem) entries;
+};
+
+TAILQ_HEAD(headname, command_elem);
+
+/// @brief очередь команд устройству. Заполняется из любого потока,
+/// отправляется потоком чтения порта между чтениями, без остановки потока данных.
+/// Элементы берутся из пула фиксированного размера, после отправки возвращаются в free_list
+typedef struct
+{
+    struct headname head;
+    struct headname free_list;
+    pthread_mutex_t lock;
+    uint64_t last_us;  // время отправки последней команды в очереди
+    uint64_t pushed;   // номер следующей команды
+    uint64_t sent;     // команды с номером меньше sent уже ушли в порт (или удалены)
+} command_queue;
+
+bool command_queue_init(command_queue *queue, struct command_elem *pool, size_t pool_len);
+bool command_queue_push(command_queue *queue, const uint8_t *command, size_t bytes, uint64_t delay_us, uint64_t *ticket);
+size_t command_queue_run(command_queue *queue, int serial_port, uint64_t now_us);
+void command_queue_drop_first(command_queue *queue);
+uint64_t command_queue_sent(command_queue *queue);
+
+#endif // COMMAND_QUEUE_H
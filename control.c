@@ -0,0 +1,590 @@
+#define _GNU_SOURCE
+
+#include "control.h"
+#include "frame.h"
+#include "rt.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+static const struct
+{
+    uint8_t code;
+    double hz;
+} rate_table[] = {
+    {0x01, 0.2}, {0x02, 0.5}, {0x03, 1}, {0x04, 2}, {0x05, 5}, {0x06, 10},
+    {0x07, 20}, {0x08, 50}, {0x09, 100}, {0x0B, 200}
+};
+
+static const struct
+{
+    const char *name;
+    uint8_t reg;
+} register_table[] = {
+    {"SAVE", SAVE}, {"CALSW", CALSW}, {"RSW", RSW}, {"RATE", RATE}, {"BAUD", BAUD},
+    {"AXOFFSET", AXOFFSET}, {"AYOFFSET", AYOFFSET}, {"AZOFFSET", AZOFFSET},
+    {"GXOFFSET", GXOFFSET}, {"GYOFFSET", GYOFFSET}, {"GZOFFSET", GZOFFSET},
+    {"HXOFFSET", HXOFFSET}, {"HYOFFSET", HYOFFSET}, {"HZOFFSET", HZOFFSET}
+};
+
+static const struct
+{
+    const char *name;
+    uint16_t bit;
+} content_table[] = {
+    {"time", TIME_REQ}, {"acc", ACCELERATION_REQ}, {"gyro", ANGULAR_VELONCY_REQ},
+    {"angle", ANGLE_REQ}, {"mag", MAGNETIC_REQ}, {"quat", QUATERION_REQ}
+};
+
+#define ARRAY_LEN(a) (sizeof(a) / sizeof((a)[0]))
+
+static volatile bool control_running = false;
+
+/// @brief частота вывода по значению регистра RATE, 0 - неизвестное значение
+double hwt905_rate_hz(uint8_t rate_code)
+{
+    for (size_t i = 0; i < ARRAY_LEN(rate_table); i++)
+    {
+        if (rate_table[i].code == rate_code)
+            return rate_table[i].hz;
+    }
+    return 0.;
+}
+
+/// @brief помещается ли поток кадров в последовательный канал: на каждый бит RSW устройство
+/// выдает по кадру HWT905_FRAME_LEN байт за цикл
+/// @return наибольшая частота из rate_table, которую выдерживает канал при маске content_mask
+static double link_max_rate_hz(uint16_t content_mask)
+{
+    double frame_bytes = (double)__builtin_popcount(content_mask) * HWT905_FRAME_LEN;
+    double best = 0.;
+
+    for (size_t i = 0; i < ARRAY_LEN(rate_table); i++)
+    {
+        if (rate_table[i].hz * frame_bytes <= CONTROL_LINK_BYTES_PER_S && rate_table[i].hz > best)
+            best = rate_table[i].hz;
+    }
+    return best;
+}
+
+static int find_register(const char *name)
+{
+    for (size_t i = 0; i < ARRAY_LEN(register_table); i++)
+    {
+        if (strcasecmp(register_table[i].name, name) == 0)
+            return register_table[i].reg;
+    }
+
+    char *end;
+    long reg = strtol(name, &end, 0);
+    return (*end == '\0' && reg >= 0 && reg <= 0xFF) ? (int)reg : -1;
+}
+
+/// @return false, если очередь команд заполнена
+static bool push_write(control_channel *ctl, uint8_t reg, uint16_t value, uint64_t delay_us)
+{
+    uint8_t unlock_cmd[] = {REQUEST_PREFIX, SECOND_REGISTER, 0x69, 0x88, 0xb5};
+    uint8_t write_cmd[] = {REQUEST_PREFIX, SECOND_REGISTER, reg, (uint8_t)(value & 0xFF), (uint8_t)(value >> 8)};
+
+    return command_queue_push(ctl->queue, unlock_cmd, sizeof(unlock_cmd), delay_us, NULL) &&
+           command_queue_push(ctl->queue, write_cmd, sizeof(write_cmd), 0, NULL);
+}
+
+/// @return false, если очередь команд заполнена
+static bool push_save(control_channel *ctl)
+{
+    uint8_t save_cmd[] = {REQUEST_PREFIX, SECOND_REGISTER, SAVE, 0x00, 0x00};
+    return command_queue_push(ctl->queue, save_cmd, sizeof(save_cmd), 0, NULL);
+}
+
+/// @brief запросить чтение регистра и дождаться ответа 0x5F
+/// @param ctl канал управления
+/// @param reg регистр
+/// @param value прочитанное значение
+/// @param timeout_ms время ожидания ответа
+/// @param reply ответ клиенту при ошибке
+/// @param reply_len размер reply
+/// @return true, если ответ получен
+static bool read_register(control_channel *ctl, uint8_t reg, uint16_t *value, uint32_t timeout_ms,
+                          char *reply, size_t reply_len)
+{
+    uint8_t read_cmd[] = {REQUEST_PREFIX, SECOND_REGISTER, READ_REGISTER_REQ, reg, 0x00};
+    struct timespec deadline;
+    bool ok = true;
+
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += timeout_ms / 1000;
+    deadline.tv_nsec += (long)(timeout_ms % 1000) * 1000000;
+    if (deadline.tv_nsec >= 1000000000)
+    {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000;
+    }
+
+    pthread_mutex_lock(&ctl->lock);
+    uint32_t seq = ctl->readback_seq;
+    ctl->readback_reg = reg;
+    ctl->readback_pending = command_queue_push(ctl->queue, read_cmd, sizeof(read_cmd), 0, &ctl->readback_ticket);
+    if (!ctl->readback_pending)
+    {
+        pthread_mutex_unlock(&ctl->lock);
+        snprintf(reply, reply_len, "ERR очередь команд заполнена\n");
+        return false;
+    }
+
+    while (ctl->readback_pending && control_running && ok)
+        ok = pthread_cond_timedwait(&ctl->readback_cond, &ctl->lock, &deadline) == 0;
+    ok = ctl->readback_seq != seq && ctl->readback_done_reg == reg;
+    if (ok)
+        *value = ctl->readback_values[0];
+    ctl->readback_pending = false;  // запоздавший ответ на это чтение будет отброшен
+    pthread_mutex_unlock(&ctl->lock);
+    if (!ok)
+        snprintf(reply, reply_len, "ERR нет ответа устройства на чтение регистра 0x%02X\n", reg);
+    return ok;
+}
+
+/// @brief записать регистр, сохранить настройки и проверить значение чтением
+static bool write_confirmed(control_channel *ctl, uint8_t reg, uint16_t value, char *reply, size_t reply_len)
+{
+    uint16_t readback;
+
+    if (!push_write(ctl, reg, value, 0) || !push_save(ctl))
+    {
+        snprintf(reply, reply_len, "ERR очередь команд заполнена\n");
+        return false;
+    }
+    if (!read_register(ctl, reg, &readback, CONTROL_READBACK_TIMEOUT_MS, reply, reply_len))
+        return false;
+    if (readback != value)
+    {
+        snprintf(reply, reply_len, "ERR регистр 0x%02X = 0x%04X, ожидалось 0x%04X\n", reg, readback, value);
+        return false;
+    }
+    return true;
+}
+
+static void cmd_set_rate(control_channel *ctl, const char *arg, char *reply, size_t reply_len)
+{
+    double hz = strtod(arg, NULL);
+    uint8_t code = 0;
+
+    for (size_t i = 0; i < ARRAY_LEN(rate_table); i++)
+    {
+        if (rate_table[i].hz == hz)
+            code = rate_table[i].code;
+    }
+    if (code == 0)
+    {
+        snprintf(reply, reply_len, "ERR допустимые частоты: 0.2 0.5 1 2 5 10 20 50 100 200\n");
+        return;
+    }
+
+    pthread_mutex_lock(&ctl->lock);
+    uint16_t content_mask = ctl->content_mask;
+    pthread_mutex_unlock(&ctl->lock);
+    double max_hz = link_max_rate_hz(content_mask);
+    if (hz > max_hz)
+    {
+        snprintf(reply, reply_len, "ERR при содержимом 0x%03X канал %d бит/с выдерживает не более %g Гц\n",
+                 content_mask, CONTROL_LINK_BYTES_PER_S * 10, max_hz);
+        return;
+    }
+
+    if (write_confirmed(ctl, RATE, code, reply, reply_len))
+    {
+        pthread_mutex_lock(&ctl->lock);
+        ctl->rate_code = code;
+        ctl->rate_changed = true;
+        pthread_mutex_unlock(&ctl->lock);
+        snprintf(reply, reply_len, "OK RATE %g\n", hz);
+    }
+}
+
+static void cmd_set_content(control_channel *ctl, char *arg, char *reply, size_t reply_len)
+{
+    uint16_t mask = 0;
+    char *save_ptr = NULL;
+
+    for (char *name = strtok_r(arg, ", ", &save_ptr); name != NULL; name = strtok_r(NULL, ", ", &save_ptr))
+    {
+        size_t i;
+        for (i = 0; i < ARRAY_LEN(content_table); i++)
+        {
+            if (strcasecmp(content_table[i].name, name) == 0)
+                break;
+        }
+        if (i == ARRAY_LEN(content_table))
+        {
+            snprintf(reply, reply_len, "ERR неизвестное содержимое %s, допустимо: time,acc,gyro,angle,mag,quat\n", name);
+            return;
+        }
+        mask |= content_table[i].bit;
+    }
+    if (mask == 0)
+    {
+        snprintf(reply, reply_len, "ERR пустой список содержимого\n");
+        return;
+    }
+
+    pthread_mutex_lock(&ctl->lock);
+    double hz = hwt905_rate_hz(ctl->rate_code);
+    pthread_mutex_unlock(&ctl->lock);
+    if (hz > link_max_rate_hz(mask))
+    {
+        snprintf(reply, reply_len, "ERR при частоте %g Гц канал %d бит/с не выдерживает содержимое 0x%03X\n",
+                 hz, CONTROL_LINK_BYTES_PER_S * 10, mask);
+        return;
+    }
+
+    if (write_confirmed(ctl, RSW, mask, reply, reply_len))
+    {
+        pthread_mutex_lock(&ctl->lock);
+        ctl->content_mask = mask;
+        ctl->content_changed = true;
+        pthread_mutex_unlock(&ctl->lock);
+        snprintf(reply, reply_len, "OK CONTENT 0x%03X\n", mask);
+    }
+}
+
+static void cmd_set_offset(control_channel *ctl, const char *name, const char *value, char *reply, size_t reply_len)
+{
+    int reg = find_register(name);
+
+    if (reg < AXOFFSET || reg > HZOFFSET || value == NULL)
+    {
+        snprintf(reply, reply_len, "ERR использование: SET OFFSET <AXOFFSET..HZOFFSET> <значение>\n");
+        return;
+    }
+    long offset = strtol(value, NULL, 0);
+    if (offset < INT16_MIN || offset > INT16_MAX)
+    {
+        snprintf(reply, reply_len, "ERR значение вне диапазона int16\n");
+        return;
+    }
+
+    if (write_confirmed(ctl, (uint8_t)reg, (uint16_t)(int16_t)offset, reply, reply_len))
+        snprintf(reply, reply_len, "OK %s %ld\n", name, offset);
+}
+
+/// @brief калибровка акселерометра: CALSW = 1, через CONTROL_CALIBRATION_US обратно в 0 и сохранение
+static void cmd_calibrate(control_channel *ctl, char *reply, size_t reply_len)
+{
+    uint16_t readback;
+
+    if (!push_write(ctl, CALSW, 0x0001, 0) || !push_write(ctl, CALSW, 0x0000, CONTROL_CALIBRATION_US) ||
+        !push_save(ctl))
+    {
+        snprintf(reply, reply_len, "ERR очередь команд заполнена\n");
+        return;
+    }
+    if (!read_register(ctl, CALSW, &readback, CONTROL_CALIBRATION_US / 1000 + CONTROL_READBACK_TIMEOUT_MS,
+                       reply, reply_len))
+        return;
+
+    if (readback != 0)
+        snprintf(reply, reply_len, "ERR CALSW = 0x%04X после калибровки\n", readback);
+    else
+        snprintf(reply, reply_len, "OK CALIBRATE\n");
+}
+
+static void cmd_get(control_channel *ctl, const char *name, char *reply, size_t reply_len)
+{
+    int reg = name ? find_register(name) : -1;
+    uint16_t value;
+
+    if (reg < 0)
+        snprintf(reply, reply_len, "ERR неизвестный регистр\n");
+    else if (read_register(ctl, (uint8_t)reg, &value, CONTROL_READBACK_TIMEOUT_MS, reply, reply_len))
+        snprintf(reply, reply_len, "OK 0x%02X 0x%04X\n", reg, value);
+}
+
+/// @brief выполнение одной строки команды
+static void handle_line(control_channel *ctl, char *line, char *reply, size_t reply_len)
+{
+    char *save_ptr = NULL;
+    char *cmd = strtok_r(line, " \t\r\n", &save_ptr);
+    char *arg1 = strtok_r(NULL, " \t\r\n", &save_ptr);
+    char *rest = strtok_r(NULL, "\r\n", &save_ptr);
+
+    if (cmd == NULL)
+    {
+        reply[0] = '\0';
+    }
+    else if (strcasecmp(cmd, "SET") == 0 && arg1 != NULL && strcasecmp(arg1, "RATE") == 0 && rest != NULL)
+    {
+        cmd_set_rate(ctl, rest, reply, reply_len);
+    }
+    else if (strcasecmp(cmd, "SET") == 0 && arg1 != NULL && strcasecmp(arg1, "CONTENT") == 0 && rest != NULL)
+    {
+        cmd_set_content(ctl, rest, reply, reply_len);
+    }
+    else if (strcasecmp(cmd, "SET") == 0 && arg1 != NULL && strcasecmp(arg1, "OFFSET") == 0 && rest != NULL)
+    {
+        char *value_ptr = NULL;
+        char *name = strtok_r(rest, " \t", &value_ptr);
+        cmd_set_offset(ctl, name, strtok_r(NULL, " \t", &value_ptr), reply, reply_len);
+    }
+    else if (strcasecmp(cmd, "CALIBRATE") == 0)
+    {
+        cmd_calibrate(ctl, reply, reply_len);
+    }
+    else if (strcasecmp(cmd, "GET") == 0)
+    {
+        cmd_get(ctl, arg1, reply, reply_len);
+    }
+    else if (strcasecmp(cmd, "STATUS") == 0)
+    {
+        pthread_mutex_lock(&ctl->lock);
+        snprintf(reply, reply_len, "OK RATE %g CONTENT 0x%03X\n", hwt905_rate_hz(ctl->rate_code), ctl->content_mask);
+        pthread_mutex_unlock(&ctl->lock);
+    }
+    else if (strcasecmp(cmd, "STATS") == 0)
+    {
+        pthread_mutex_lock(&ctl->lock);
+        control_report_fn stats_fn = ctl->stats_fn;
+        void *stats_arg = ctl->stats_arg;
+        pthread_mutex_unlock(&ctl->lock);
+
+        if (stats_fn == NULL)
+        {
+            snprintf(reply, reply_len, "ERR статистика недоступна\n");
+            return;
+        }
+        size_t len = (size_t)snprintf(reply, reply_len, "OK STATS\n");
+        stats_fn(reply + len, reply_len - len, stats_arg);
+    }
+    else if (strcasecmp(cmd, "SPECTRUM") == 0)
+    {
+        pthread_mutex_lock(&ctl->lock);
+        control_report_fn spectrum_fn = ctl->spectrum_fn;
+        void *spectrum_arg = ctl->spectrum_arg;
+        pthread_mutex_unlock(&ctl->lock);
+
+        if (spectrum_fn == NULL)
+        {
+            snprintf(reply, reply_len, "ERR спектр не включен (-S)\n");
+            return;
+        }
+        size_t len = (size_t)snprintf(reply, reply_len, "OK SPECTRUM\n");
+        if (spectrum_fn(reply + len, reply_len - len, spectrum_arg) == 0)
+            snprintf(reply, reply_len, "ERR окно спектра еще не заполнено\n");
+    }
+    else
+    {
+        snprintf(reply, reply_len, "ERR команды: SET RATE <Гц> | SET CONTENT <список> | SET OFFSET <регистр> <значение> | "
+                 "CALIBRATE | GET <регистр> | STATUS | STATS | SPECTRUM\n");
+    }
+}
+
+/// @brief проверка, что подключился процесс того же пользователя (или root)
+static bool peer_allowed(int fd)
+{
+    struct ucred cred;
+    socklen_t len = sizeof(cred);
+
+    if (getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &len) != 0)
+        return false;
+    return cred.uid == 0 || cred.uid == geteuid();
+}
+
+static void serve_client(control_channel *ctl, int fd)
+{
+    char line[CONTROL_LINE_MAX];
+    char reply[CONTROL_REPLY_MAX];
+    size_t len = 0;
+
+    while (control_running)
+    {
+        ssize_t n = recv(fd, line + len, sizeof(line) - 1 - len, 0);
+        if (n <= 0)
+            return;
+        len += (size_t)n;
+        line[len] = '\0';
+
+        char *newline;
+        while ((newline = strchr(line, '\n')) != NULL)
+        {
+            *newline = '\0';
+            handle_line(ctl, line, reply, sizeof(reply));
+            if (reply[0] != '\0' && send(fd, reply, strlen(reply), MSG_NOSIGNAL) < 0)
+                return;
+
+            size_t consumed = (size_t)(newline - line) + 1;
+            memmove(line, newline + 1, len - consumed + 1);
+            len -= consumed;
+        }
+        if (len == sizeof(line) - 1)
+            return;  // слишком длинная строка
+    }
+}
+
+static void* control_thread_function(void *arg)
+{
+    control_channel *ctl = (control_channel*) arg;
+
+    while (control_running)
+    {
+        int fd = accept(ctl->listen_fd, NULL, NULL);
+        if (fd < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            break;
+        }
+        pthread_mutex_lock(&ctl->lock);
+        ctl->client_fd = fd;
+        pthread_mutex_unlock(&ctl->lock);
+        if (peer_allowed(fd))
+            serve_client(ctl, fd);
+        pthread_mutex_lock(&ctl->lock);
+        ctl->client_fd = -1;
+        pthread_mutex_unlock(&ctl->lock);
+        close(fd);
+    }
+    return NULL;
+}
+
+/// @brief запуск канала управления в отдельном потоке
+/// @param ctl канал управления
+/// @param path путь к Unix сокету
+/// @param queue очередь команд устройству
+/// @param rate_code текущее значение регистра RATE
+/// @param content_mask текущее значение регистра RSW
+/// @return true в случае успеха
+bool control_start(control_channel *ctl, const char *path, command_queue *queue, uint8_t rate_code, uint16_t content_mask)
+{
+    struct sockaddr_un address = {0};
+
+    memset(ctl, 0, sizeof(*ctl));
+    ctl->queue = queue;
+    ctl->client_fd = -1;
+    ctl->rate_code = rate_code;
+    ctl->content_mask = content_mask;
+    snprintf(ctl->path, sizeof(ctl->path), "%s", path);
+
+    if ((ctl->listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0)) < 0)
+    {
+        perror("socket failed");
+        return false;
+    }
+
+    address.sun_family = AF_UNIX;
+    snprintf(address.sun_path, sizeof(address.sun_path), "%s", ctl->path);
+    unlink(ctl->path);
+
+    mode_t old_mask = umask(0177);  // сокет доступен только владельцу
+    int bound = bind(ctl->listen_fd, (struct sockaddr*)&address, sizeof(address));
+    umask(old_mask);
+    if (bound < 0 || listen(ctl->listen_fd, 4) < 0)
+    {
+        perror("control bind/listen");
+        close(ctl->listen_fd);
+        return false;
+    }
+
+    pthread_mutex_init(&ctl->lock, NULL);
+    pthread_cond_init(&ctl->readback_cond, NULL);
+    control_running = true;
+    if (!rt_thread_create(&ctl->thread, CONTROL_THREAD_STACK, control_thread_function, ctl))
+    {
+        printf("Error %i from pthread_create: %s\n", errno, strerror(errno));
+        control_running = false;
+        close(ctl->listen_fd);
+        return false;
+    }
+
+    printf("Канал управления: %s\n", ctl->path);
+    return true;
+}
+
+/// @brief ответ устройства на чтение регистра (кадр 0x55 0x5F, четыре регистра подряд).
+/// В кадре нет адреса регистра, поэтому ответ относится к ожидающему чтению, только если его запрос
+/// уже ушел в порт; ответы без ожидающего чтения или пришедшие раньше запроса (от прошлых команд)
+/// отбрасываются. Вызывается потоком чтения порта, тем же, что отправляет очередь команд
+void control_on_readback(control_channel *ctl, const uint8_t *frame)
+{
+    pthread_mutex_lock(&ctl->lock);
+    if (!ctl->readback_pending || command_queue_sent(ctl->queue) <= ctl->readback_ticket)
+    {
+        pthread_mutex_unlock(&ctl->lock);
+        printf("Канал управления: ответ 0x5F без ожидающего чтения отброшен\n");
+        return;
+    }
+    for (int i = 0; i < 4; i++)
+        ctl->readback_values[i] = (uint16_t)(frame[2 + 2 * i] | (frame[3 + 2 * i] << 8));
+    ctl->readback_done_reg = ctl->readback_reg;
+    ctl->readback_pending = false;
+    ctl->readback_seq++;
+    pthread_cond_broadcast(&ctl->readback_cond);
+    pthread_mutex_unlock(&ctl->lock);
+}
+
+/// @brief задать функцию отчета для команды STATS (вызывается из потока канала управления)
+void control_set_stats(control_channel *ctl, control_report_fn stats_fn, void *arg)
+{
+    pthread_mutex_lock(&ctl->lock);
+    ctl->stats_fn = stats_fn;
+    ctl->stats_arg = arg;
+    pthread_mutex_unlock(&ctl->lock);
+}
+
+/// @brief задать функцию отчета для команды SPECTRUM
+void control_set_spectrum(control_channel *ctl, control_report_fn spectrum_fn, void *arg)
+{
+    pthread_mutex_lock(&ctl->lock);
+    ctl->spectrum_fn = spectrum_fn;
+    ctl->spectrum_arg = arg;
+    pthread_mutex_unlock(&ctl->lock);
+}
+
+/// @brief забрать подтвержденное изменение частоты вывода
+/// @return true, если частота изменилась с прошлого вызова
+bool control_take_rate(control_channel *ctl, uint8_t *rate_code)
+{
+    pthread_mutex_lock(&ctl->lock);
+    bool changed = ctl->rate_changed;
+    ctl->rate_changed = false;
+    *rate_code = ctl->rate_code;
+    pthread_mutex_unlock(&ctl->lock);
+    return changed;
+}
+
+/// @brief забрать подтвержденное изменение содержимого вывода (RSW)
+/// @return true, если содержимое изменилось с прошлого вызова
+bool control_take_content(control_channel *ctl, uint16_t *content_mask)
+{
+    pthread_mutex_lock(&ctl->lock);
+    bool changed = ctl->content_changed;
+    ctl->content_changed = false;
+    *content_mask = ctl->content_mask;
+    pthread_mutex_unlock(&ctl->lock);
+    return changed;
+}
+
+void control_stop(control_channel *ctl)
+{
+    if (!control_running)
+        return;
+
+    control_running = false;
+    // поток может ждать в accept, в recv клиента или ответа устройства: будим все три
+    shutdown(ctl->listen_fd, SHUT_RDWR);
+    pthread_mutex_lock(&ctl->lock);
+    if (ctl->client_fd >= 0)
+        shutdown(ctl->client_fd, SHUT_RDWR);
+    pthread_cond_broadcast(&ctl->readback_cond);
+    pthread_mutex_unlock(&ctl->lock);
+    pthread_join(ctl->thread, NULL);
+
+    close(ctl->listen_fd);
+    unlink(ctl->path);
+}
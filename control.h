@@ -0,0 +1,64 @@
+#ifndef CONTROL_H
+#define CONTROL_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+#include "hwt905.h"
+#include "command_queue.h"
+
+#define CONTROL_DEFAULT_PATH "/tmp/hwt905.ctl"
+#define CONTROL_LINE_MAX 256
+#define CONTROL_REPLY_MAX 2048           // ответ STATS занимает несколько строк
+#define CONTROL_READBACK_TIMEOUT_MS 2000
+#define CONTROL_CALIBRATION_US 5000000  // длительность калибровки акселерометра
+#define CONTROL_LINK_BYTES_PER_S 960    // 9600 бод, 8N1: 10 бит на байт
+#define CONTROL_THREAD_STACK (64 * 1024) // стек потока канала управления: строка, ответ STATS и форматирование
+
+/// @brief канал управления через Unix сокет. Доступ ограничен правами файла сокета (0600)
+/// и проверкой uid подключившегося процесса (SO_PEERCRED).
+/// Команды: SET RATE <Гц>, SET CONTENT <time,acc,gyro,angle,mag,quat>, SET OFFSET <регистр> <значение>,
+/// CALIBRATE, GET <регистр>, STATUS, STATS, SPECTRUM. Команды устройству ставятся в очередь command_queue,
+/// результат подтверждается чтением регистра обратно (кадр 0x5F)
+typedef size_t (*control_report_fn)(char *buf, size_t len, void *arg);
+
+typedef struct
+{
+    char path[108];
+    int listen_fd;
+    int client_fd;              // обслуживаемый клиент, -1 если нет; под lock
+    pthread_t thread;
+    command_queue *queue;
+
+    pthread_mutex_t lock;
+    pthread_cond_t readback_cond;
+    uint8_t readback_reg;       // регистр, чтение которого ожидается
+    bool readback_pending;      // чтение запрошено, ответ еще не получен
+    uint64_t readback_ticket;   // номер запроса чтения в очереди команд
+    uint8_t readback_done_reg;  // регистр, к которому отнесен последний ответ
+    uint32_t readback_seq;      // увеличивается при каждом принятом ответе 0x5F
+    uint16_t readback_values[4];
+
+    uint8_t rate_code;          // текущее значение регистра RATE
+    uint16_t content_mask;      // текущее значение регистра RSW
+    bool rate_changed;          // изменения, которые поток чтения должен применить
+    bool content_changed;
+
+    control_report_fn stats_fn;     // отчет для команды STATS
+    void *stats_arg;
+    control_report_fn spectrum_fn;  // отчет для команды SPECTRUM
+    void *spectrum_arg;
+} control_channel;
+
+bool control_start(control_channel *ctl, const char *path, command_queue *queue, uint8_t rate_code, uint16_t content_mask);
+void control_on_readback(control_channel *ctl, const uint8_t *frame);
+bool control_take_rate(control_channel *ctl, uint8_t *rate_code);
+bool control_take_content(control_channel *ctl, uint16_t *content_mask);
+void control_set_stats(control_channel *ctl, control_report_fn stats_fn, void *arg);
+void control_set_spectrum(control_channel *ctl, control_report_fn spectrum_fn, void *arg);
+double hwt905_rate_hz(uint8_t rate_code);
+void control_stop(control_channel *ctl);
+
+#endif // CONTROL_H
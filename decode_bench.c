@@ -0,0 +1,191 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+
+#include "epoch.h"
+
+// Замер разбора кадров в цикле чтения: немедленное (eager) преобразование всех кадров и ленивое (lazy)
+// преобразование только кадров, нужных подписчикам.
+// decode_bench [-n проходов] - поток из CYCLES циклов по 6 кадров (TIME, ускорение, угловая скорость, угол,
+// магнитное поле, кватернион) проходит тот же путь, что в main.c: hwt905_frame_check, TIME преобразуется
+// сразу (нужен часам), epoch_push. Eager на каждый цикл преобразует все полученные кадры, lazy - только кадры
+// подписки (epoch_decode). Для каждой подписки выводятся нс на цикл и доля одного ядра при 200 Гц.
+// Значения lazy сравниваются с eager по кадрам подписки (код возврата 1 при расхождении)
+
+#define CYCLES 4096
+#define CYCLE_FRAMES 6
+#define RATE_HZ 200
+#define REPEATS 5
+
+typedef struct
+{
+    const char *name;
+    uint16_t fields;
+} subscription;
+
+static const subscription subscriptions[] = {
+    {"-f raw", 0},
+    {"триггер acc:", EPOCH_BIT(ACCELERATION)},
+    {"-f human", EPOCH_HUMAN_FIELDS},
+    {"-f human, триггер, спектр", EPOCH_HUMAN_FIELDS | EPOCH_BIT(ACCELERATION) | EPOCH_BIT(ANGULAR_VELONCY)},
+    {"-f json, архив, HTTP", EPOCH_DEFAULT_MASK},
+};
+
+static uint8_t stream[CYCLES * CYCLE_FRAMES][HWT905_FRAME_LEN];
+
+static double now_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void random_frame(uint8_t *frame, uint8_t type)
+{
+    uint8_t sum = 0;
+
+    frame[0] = START;
+    frame[1] = type;
+    for (int i = 2; i < HWT905_FRAME_LEN - 1; i++)
+        frame[i] = (uint8_t)rand();
+    for (int i = 0; i < HWT905_FRAME_LEN - 1; i++)
+        sum += frame[i];
+    frame[HWT905_FRAME_LEN - 1] = sum;
+}
+
+static void fill_stream(void)
+{
+    static const uint8_t types[CYCLE_FRAMES] = {TIME, ACCELERATION, ANGULAR_VELONCY, ANGLE, MAGNETIC, QUATERION};
+
+    srand(7);
+    for (size_t i = 0; i < CYCLES * CYCLE_FRAMES; i++)
+        random_frame(stream[i], types[i % CYCLE_FRAMES]);
+}
+
+/// @brief один проход по потоку
+/// @param fields кадры, которые преобразуются в каждом цикле
+/// @param sink сумма значений, чтобы преобразование не было выброшено компилятором
+/// @return количество выданных циклов
+static unsigned long run(uint16_t fields, double *sink)
+{
+    epoch_assembler assembler;
+    hwt905_epoch epoch;
+    hwt905_values time_values;
+    enum FRAME_CHECK result;
+    unsigned long epochs = 0;
+
+    epoch_init(&assembler, EPOCH_DEFAULT_MASK);
+    for (size_t i = 0; i < CYCLES * CYCLE_FRAMES; i++)
+    {
+        uint8_t type = hwt905_frame_check(stream[i], &result);
+        if (type == TIME)
+            hwt905_decode_frame(stream[i], &time_values);
+        if (!epoch_push(&assembler, type, stream[i], i, &epoch))
+            continue;
+        const hwt905_values *v = epoch_decode(&epoch, fields);
+        *sink += v->acceleration[0] + v->angularVelocity[1] + v->angle[2] + v->quaterion[3] + v->magneta[0];
+        epochs++;
+    }
+    *sink += time_values.ms;
+    return epochs;
+}
+
+/// @brief значения lazy совпадают с eager по кадрам подписки
+static unsigned long check(uint16_t fields)
+{
+    epoch_assembler eager_assembler, lazy_assembler;
+    hwt905_epoch eager, lazy;
+    enum FRAME_CHECK result;
+    unsigned long mismatches = 0;
+
+    epoch_init(&eager_assembler, EPOCH_DEFAULT_MASK);
+    epoch_init(&lazy_assembler, EPOCH_DEFAULT_MASK);
+    for (size_t i = 0; i < CYCLES * CYCLE_FRAMES; i++)
+    {
+        uint8_t type = hwt905_frame_check(stream[i], &result);
+        bool emitted = epoch_push(&eager_assembler, type, stream[i], i, &eager);
+        if (epoch_push(&lazy_assembler, type, stream[i], i, &lazy) != emitted)
+            return 1;
+        if (!emitted)
+            continue;
+
+        const hwt905_values *e = epoch_decode(&eager, EPOCH_DEFAULT_MASK);
+        const hwt905_values *l = epoch_decode(&lazy, fields);
+        bool equal = true;
+        for (int k = 0; k < 3; k++)
+        {
+            if (fields & EPOCH_BIT(ACCELERATION))
+                equal = equal && e->acceleration[k] == l->acceleration[k];
+            if (fields & EPOCH_BIT(ANGULAR_VELONCY))
+                equal = equal && e->angularVelocity[k] == l->angularVelocity[k];
+            if (fields & EPOCH_BIT(ANGLE))
+                equal = equal && e->angle[k] == l->angle[k];
+            if (fields & EPOCH_BIT(MAGNETIC))
+                equal = equal && e->magneta[k] == l->magneta[k];
+        }
+        if (fields & EPOCH_BIT(QUATERION))
+        {
+            for (int k = 0; k < 4; k++)
+                equal = equal && e->quaterion[k] == l->quaterion[k];
+        }
+        if (!equal)
+            mismatches++;
+    }
+    return mismatches;
+}
+
+/// @brief наименьшее из REPEATS измерений, нс на цикл: разброс от вытеснения процесса не попадает в результат
+static double measure(uint16_t fields, int rounds, double *sink)
+{
+    double best = 0;
+
+    for (int repeat = 0; repeat < REPEATS; repeat++)
+    {
+        unsigned long epochs = 0;
+        double start = now_seconds();
+        for (int r = 0; r < rounds; r++)
+            epochs += run(fields, sink);
+        double ns = (now_seconds() - start) / epochs * 1e9;
+        if (repeat == 0 || ns < best)
+            best = ns;
+    }
+    return best;
+}
+
+int main(int argc, char *argv[])
+{
+    int rounds = 200;
+    int opt;
+    double sink = 0;
+    unsigned long mismatches = 0;
+
+    while ((opt = getopt(argc, argv, "n:")) != -1)
+    {
+        if (opt != 'n')
+        {
+            printf("Использование: %s [-n проходов]\n", argv[0]);
+            return 1;
+        }
+        rounds = atoi(optarg);
+    }
+
+    fill_stream();
+    measure(EPOCH_DEFAULT_MASK, 1, &sink);  // прогрев
+
+    // eager не зависит от подписки: все полученные кадры преобразуются всегда
+    double eager_ns = measure(EPOCH_DEFAULT_MASK, rounds, &sink);
+    printf("Циклов %d по %d кадров, проходов %d (лучшее из %d). Время на цикл, доля ядра при %d Гц:\n",
+           CYCLES, CYCLE_FRAMES, rounds, REPEATS, RATE_HZ);
+    printf("  eager %6.1f нс (%.4f%%)             - любая подписка\n", eager_ns, eager_ns * RATE_HZ / 1e7);
+    for (size_t i = 0; i < sizeof(subscriptions) / sizeof(subscriptions[0]); i++)
+    {
+        double lazy_ns = measure(subscriptions[i].fields, rounds, &sink);
+        mismatches += check(subscriptions[i].fields);
+        printf("  lazy  %6.1f нс (%.4f%%), %.2f от eager - %s\n",
+               lazy_ns, lazy_ns * RATE_HZ / 1e7, lazy_ns / eager_ns, subscriptions[i].name);
+    }
+    printf("Расхождений lazy и eager: %lu (контрольная сумма %g)\n", mismatches, sink);
+    return mismatches != 0;
+}
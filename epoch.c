@@ -0,0 +1,84 @@
+#include "epoch.h"
+
+#include <string.h>
+
+/// @brief начальное состояние сборщика
+/// @param assembler сборщик
+/// @param expected_mask ожидаемое содержимое цикла, биты RSW
+void epoch_init(epoch_assembler *assembler, uint16_t expected_mask)
+{
+    memset(assembler, 0, sizeof(*assembler));
+    assembler->expected_mask = expected_mask;
+}
+
+static void emit(epoch_assembler *assembler, hwt905_epoch *out)
+{
+    out->seq = assembler->next_seq++;
+    out->mask = assembler->mask;
+    out->decoded = 0;
+    memcpy(out->frames, assembler->frames, sizeof(out->frames));
+    memset(&out->values, 0, sizeof(out->values));
+    out->values.timestamp_us = assembler->timestamp_us;
+
+    assembler->emitted++;
+    if ((assembler->mask & assembler->expected_mask) != assembler->expected_mask)
+        assembler->incomplete++;
+    assembler->mask = 0;
+}
+
+/// @brief добавить проверенный кадр. Кадр не разбирается, сохраняются только его байты
+/// @param assembler сборщик
+/// @param frame_type тип кадра (результат hwt905_frame_check), 0 - кадр не прошел проверку
+/// @param frame байты кадра
+/// @param timestamp_us время измерения кадра, монотонные мкс
+/// @param out запись цикла, заполняется, если цикл завершен
+/// @return true, если в out записан завершенный цикл
+bool epoch_push(epoch_assembler *assembler, uint8_t frame_type, const uint8_t *frame, uint64_t timestamp_us,
+                hwt905_epoch *out)
+{
+    if (frame_type < TIME || frame_type > QUATERION)
+        return false;
+
+    uint16_t bit = EPOCH_BIT(frame_type);
+    bool emitted = false;
+
+    // начало следующего цикла: кадр TIME или повтор уже полученного кадра
+    if (assembler->mask != 0 &&
+        ((assembler->mask & bit) || (frame_type == TIME && (assembler->expected_mask & bit))))
+    {
+        emit(assembler, out);
+        emitted = true;
+    }
+
+    memcpy(assembler->frames[frame_type - TIME], frame, HWT905_FRAME_LEN);
+    if (frame_type == TIME || assembler->mask == 0)
+        assembler->timestamp_us = timestamp_us;
+    assembler->mask |= bit;
+
+    if (!emitted && (assembler->mask & assembler->expected_mask) == assembler->expected_mask)
+    {
+        emit(assembler, out);
+        emitted = true;
+    }
+    return emitted;
+}
+
+/// @brief преобразовать в values кадры fields, которые получены в этом цикле и еще не преобразованы.
+/// Поля кадров, которых нет в epoch->mask, остаются равными 0
+/// @param epoch запись цикла
+/// @param fields нужные кадры, биты RSW
+/// @return values записи
+const hwt905_values* epoch_decode(hwt905_epoch *epoch, uint16_t fields)
+{
+    uint16_t todo = fields & epoch->mask & ~epoch->decoded;
+
+    // по возрастанию типа, как кадры приходят от устройства: температура берется из последнего кадра
+    while (todo != 0)
+    {
+        int index = __builtin_ctz(todo);
+        hwt905_decode_frame(epoch->frames[index], &epoch->values);
+        todo &= todo - 1;
+    }
+    epoch->decoded |= fields & epoch->mask;
+    return &epoch->values;
+}
@@ -0,0 +1,51 @@
+#ifndef EPOCH_H
+#define EPOCH_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "hwt905.h"
+#include "frame.h"
+
+// биты маски содержимого совпадают с битами регистра RSW: кадр 0x50 + n -> бит n
+#define EPOCH_BIT(frame_type) ((uint16_t)(1u << ((frame_type) - TIME)))
+#define EPOCH_DEFAULT_MASK (EPOCH_BIT(TIME) | EPOCH_BIT(ACCELERATION) | EPOCH_BIT(ANGULAR_VELONCY) | \
+                            EPOCH_BIT(ANGLE) | EPOCH_BIT(MAGNETIC) | EPOCH_BIT(QUATERION))
+
+// поля, которые нужны текстовому выводу по умолчанию: ускорение, угловая скорость, магнитное поле, температура
+#define EPOCH_HUMAN_FIELDS (EPOCH_BIT(ACCELERATION) | EPOCH_BIT(ANGULAR_VELONCY) | EPOCH_BIT(MAGNETIC))
+
+/// @brief полная запись одного цикла вывода устройства
+/// seq - порядковый номер цикла, mask - какие кадры цикла получены (биты RSW).
+/// Запись хранит проверенные сырые кадры; values заполняется лениво через epoch_decode,
+/// только для запрошенных кадров этого цикла и один раз (decoded - уже преобразованные кадры).
+/// Поля кадров, которых нет в mask, равны 0: значения прошлых циклов в запись не попадают
+typedef struct
+{
+    uint32_t seq;
+    uint16_t mask;
+    uint16_t decoded;
+    uint8_t frames[FRAME_TYPES][HWT905_FRAME_LEN];
+    hwt905_values values;
+} hwt905_epoch;
+
+/// @brief сборка кадров 0x50..0x59 одного цикла устройства в одну запись.
+/// Цикл заканчивается, когда получены все кадры expected_mask, когда приходит кадр TIME
+/// (если он есть в маске - устройство выдает его первым) или когда тип кадра повторяется
+typedef struct
+{
+    uint16_t expected_mask;
+    uint16_t mask;
+    uint32_t next_seq;
+    uint64_t timestamp_us;
+    uint8_t frames[FRAME_TYPES][HWT905_FRAME_LEN];
+    uint64_t emitted;
+    uint64_t incomplete;
+} epoch_assembler;
+
+void epoch_init(epoch_assembler *assembler, uint16_t expected_mask);
+bool epoch_push(epoch_assembler *assembler, uint8_t frame_type, const uint8_t *frame, uint64_t timestamp_us,
+                hwt905_epoch *out);
+const hwt905_values* epoch_decode(hwt905_epoch *epoch, uint16_t fields);
+
+#endif // EPOCH_H
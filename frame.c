@@ -0,0 +1,76 @@
+#include "frame.h"
+
+/// @brief проверка кадра: заголовок 0x55, контрольная сумма и известный тип, без вывода
+/// (отказы учитываются вызывающим по result, см. pipeline_stats)
+/// @param frame кадр HWT905_FRAME_LEN байт
+/// @param result причина отказа для учета потерь, может быть NULL
+/// @return тип кадра (enum REGISTERS) или 0, если кадр не прошел проверку
+uint8_t hwt905_frame_check(const uint8_t *frame, enum FRAME_CHECK *result)
+{
+    enum FRAME_CHECK dummy;
+    uint8_t sum = 0;
+
+    if (result == NULL)
+        result = &dummy;
+    *result = FRAME_CHECK_OK;
+    if (frame[0] != START)
+    {
+        *result = FRAME_CHECK_START;
+        return 0;
+    }
+    for (size_t i = 0; i < HWT905_FRAME_LEN - 1; i++)
+        sum += frame[i];
+    if (sum != frame[HWT905_FRAME_LEN - 1])
+    {
+        *result = FRAME_CHECK_CRC;
+        return 0;
+    }
+
+    if ((frame[1] >= TIME && frame[1] <= QUATERION) || frame[1] == READ_REGISTER)
+        return frame[1];
+    *result = FRAME_CHECK_TYPE;
+    return 0;
+}
+
+/// @brief преобразование проверенного кадра в физические величины, без вывода.
+/// Меняются только поля своего типа кадра, как в parse_hwt905_answer
+/// @param frame кадр HWT905_FRAME_LEN байт
+/// @param values значения
+void hwt905_decode_frame(const uint8_t *frame, hwt905_values *values)
+{
+    switch (frame[1])
+    {
+    case TIME:
+        values->YY = frame[2];
+        values->MM = frame[3];
+        values->DD = frame[4];
+        values->hh = frame[5];
+        values->mm = frame[6];
+        values->ss = frame[7];
+        values->ms = (frame[8] | (frame[9] << 8));
+        break;
+    case ACCELERATION:
+        for (size_t i = 0; i < 3; i++)
+            values->acceleration[i] = hwt905_acc_from_raw(hwt905_frame_word(frame, i));
+        values->temperature = hwt905_temp_from_raw(hwt905_frame_word(frame, 3));
+        break;
+    case ANGULAR_VELONCY:
+        for (size_t i = 0; i < 3; i++)
+            values->angularVelocity[i] = hwt905_gyro_from_raw(hwt905_frame_word(frame, i));
+        values->temperature = hwt905_temp_from_raw(hwt905_frame_word(frame, 3));
+        break;
+    case ANGLE:
+        for (size_t i = 0; i < 3; i++)
+            values->angle[i] = hwt905_angle_from_raw(hwt905_frame_word(frame, i));
+        values->version = (uint16_t)hwt905_frame_word(frame, 3);
+        break;
+    case MAGNETIC:
+        for (size_t i = 0; i < 3; i++)
+            values->magneta[i] = hwt905_frame_word(frame, i);
+        break;
+    case QUATERION:
+        for (size_t i = 0; i < 4; i++)
+            values->quaterion[i] = hwt905_quat_from_raw(hwt905_frame_word(frame, i));
+        break;
+    }
+}
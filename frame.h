@@ -0,0 +1,39 @@
+#ifndef FRAME_H
+#define FRAME_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#include "hwt905.h"
+
+#define HWT905_FRAME_LEN 11
+#define FRAME_TYPES (QUATERION - TIME + 1)   // кадры 0x50..0x59, индекс = тип - TIME
+#define HWT905_G 9.8f                        // float, как G в parse_hwt905_answer, чтобы результат совпадал побайтно
+
+/// @brief слово данных кадра со знаком: байты 2 + 2 * word (младший) и 3 + 2 * word
+static inline int16_t hwt905_frame_word(const uint8_t *frame, size_t word)
+{
+    return (int16_t)(frame[2 + 2 * word] | (frame[3 + 2 * word] << 8));
+}
+
+// перевод сырых значений в физические величины
+static inline double hwt905_acc_from_raw(int16_t raw) { return raw / 32768. * 16 * HWT905_G; }     // м/с^2
+static inline double hwt905_gyro_from_raw(int16_t raw) { return raw / 32768. * 2000; }            // град/с
+static inline double hwt905_angle_from_raw(int16_t raw) { return raw / 32768. * 180; }            // град
+static inline double hwt905_quat_from_raw(int16_t raw) { return raw / 32768.; }
+static inline double hwt905_temp_from_raw(int16_t raw) { return raw / 100.; }                     // град C
+
+/// @brief причина, по которой кадр не прошел проверку
+enum FRAME_CHECK
+{
+    FRAME_CHECK_OK,
+    FRAME_CHECK_START,     // нет заголовка 0x55
+    FRAME_CHECK_CRC,       // неверная контрольная сумма
+    FRAME_CHECK_TYPE       // неизвестный тип кадра
+};
+
+uint8_t hwt905_frame_check(const uint8_t *frame, enum FRAME_CHECK *result);
+void hwt905_decode_frame(const uint8_t *frame, hwt905_values *values);
+
+#endif // FRAME_H
@@ -0,0 +1,347 @@
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <poll.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/socket.h>
+#include <sys/resource.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "http_stream.h"
+
+// Нагрузочная проверка HTTP сервера на петлевом интерфейсе.
+// http_load [-c клиентов] [-s медленных] [-r Гц] [-d секунд] [-p порт]
+// В процессе запускается http_server, к нему подключаются клиенты GET /stream. Быстрые клиенты читают
+// все, медленные - маленький буфер приема и чтение порциями раз в SLOW_READ_MS, поэтому сервер упирается
+// в неблокирующую запись: недописанные события уходят через carry, отставшие клиенты пропускают события.
+// Каждое событие разбирается целиком: разорванное или перемешанное событие - ошибка (код возврата 1),
+// пропуски по номерам считаются отдельно для быстрых и медленных клиентов
+
+#define SLOW_RCVBUF 4096       // буфер приема медленного клиента
+#define SLOW_READ_MS 100       // период чтения медленного клиента
+#define SLOW_READ_BYTES 2048   // байт за одно чтение: 20 КБ/с, поток при 200 Гц втрое больше
+#define CLIENT_BUFFER 8192     // неразобранный хвост потока клиента
+
+typedef struct
+{
+    int fd;
+    bool slow;
+    bool streaming;            // заголовок ответа получен
+    char buffer[CLIENT_BUFFER];
+    size_t len;
+    uint64_t events;
+    uint64_t gaps;             // пропущенные номера событий
+    uint64_t malformed;
+    uint64_t last_id;
+    bool first;
+} load_client;
+
+static uint64_t monotonic_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static int connect_client(uint16_t port, bool slow)
+{
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0)
+        return -1;
+    if (slow)
+    {
+        int rcvbuf = SLOW_RCVBUF;
+        setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+    }
+
+    struct sockaddr_in address = {0};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = htons(port);
+    static const char request[] = "GET /stream HTTP/1.1\r\nHost: localhost\r\n\r\n";
+    if (connect(fd, (struct sockaddr*)&address, sizeof(address)) < 0 ||
+        send(fd, request, sizeof(request) - 1, MSG_NOSIGNAL) != sizeof(request) - 1)
+    {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/// @brief разбор событий из буфера клиента: "id: N\ndata: {...}\n\n"
+static void parse_events(load_client *client)
+{
+    size_t off = 0;
+
+    if (!client->streaming)
+    {
+        char *end = memmem(client->buffer, client->len, "\r\n\r\n", 4);
+        if (end == NULL)
+            return;
+        if (strncmp(client->buffer, "HTTP/1.1 200", 12) != 0)
+            client->malformed++;
+        client->streaming = true;
+        off = (size_t)(end - client->buffer) + 4;
+    }
+
+    while (true)
+    {
+        char *begin = client->buffer + off;
+        char *end = memmem(begin, client->len - off, "\n\n", 2);
+        if (end == NULL)
+            break;
+
+        unsigned long long id;
+        int data_off = 0;
+        char *close_brace = end - 1;
+        if (sscanf(begin, "id: %llu\ndata: %n", &id, &data_off) != 1 || data_off == 0 ||
+            begin[data_off] != '{' || *close_brace != '}')
+        {
+            client->malformed++;
+        }
+        else
+        {
+            // номер в id совпадает с полем seq объекта: часть одного события не попала в другое
+            char seq_field[32];
+            int seq_len = snprintf(seq_field, sizeof(seq_field), "{\"seq\":%llu,", id);
+            if (strncmp(begin + data_off, seq_field, (size_t)seq_len) != 0 || (!client->first && id <= client->last_id))
+                client->malformed++;
+            else
+            {
+                if (!client->first)
+                    client->gaps += id - client->last_id - 1;
+                client->first = false;
+                client->last_id = id;
+                client->events++;
+            }
+        }
+        off = (size_t)(end - client->buffer) + 2;
+    }
+
+    memmove(client->buffer, client->buffer + off, client->len - off);
+    client->len -= off;
+}
+
+/// @brief чтение клиента
+/// @return false, если соединение закрыто
+static bool read_client(load_client *client, size_t limit)
+{
+    size_t room = sizeof(client->buffer) - client->len;
+    if (room > limit)
+        room = limit;
+    if (room == 0)
+    {
+        client->malformed++;  // событие длиннее буфера - поток испорчен
+        client->len = 0;
+        return true;
+    }
+
+    ssize_t n = recv(client->fd, client->buffer + client->len, room, MSG_DONTWAIT);
+    if (n == 0)
+        return false;
+    if (n < 0)
+        return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+    client->len += (size_t)n;
+    parse_events(client);
+    return true;
+}
+
+/// @brief обслуживание клиентов до момента until_ms
+static void pump_clients(load_client *clients, size_t count, struct pollfd *fds, uint64_t until_ms,
+                         uint64_t *slow_read_ms)
+{
+    uint64_t now;
+
+    while ((now = monotonic_ms()) < until_ms)
+    {
+        bool slow_turn = now >= *slow_read_ms;
+        if (slow_turn)
+            *slow_read_ms = now + SLOW_READ_MS;
+
+        for (size_t i = 0; i < count; i++)
+        {
+            bool wanted = clients[i].fd >= 0 && (!clients[i].slow || slow_turn || !clients[i].streaming);
+            fds[i] = (struct pollfd) {wanted ? clients[i].fd : -1, POLLIN, 0};
+        }
+        int timeout = (int)(until_ms - now);
+        if (timeout > 10)
+            timeout = 10;
+        if (poll(fds, count, timeout) <= 0)
+            continue;
+
+        for (size_t i = 0; i < count; i++)
+        {
+            if (!(fds[i].revents & (POLLIN | POLLHUP | POLLERR)))
+                continue;
+            size_t limit = clients[i].slow && clients[i].streaming ? SLOW_READ_BYTES : sizeof(clients[i].buffer);
+            if (!read_client(&clients[i], limit))
+            {
+                close(clients[i].fd);
+                clients[i].fd = -1;
+            }
+        }
+    }
+}
+
+static void usage(const char *name)
+{
+    printf("Использование: %s [-c clients] [-s slow] [-r hz] [-d seconds] [-p port]\n", name);
+}
+
+int main(int argc, char *argv[])
+{
+    size_t count = 400, slow = 40;
+    double rate_hz = 200;
+    double seconds = 10;
+    uint16_t port = 18081;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "c:s:r:d:p:")) != -1)
+    {
+        switch (opt)
+        {
+        case 'c':
+            count = strtoul(optarg, NULL, 0);
+            break;
+        case 's':
+            slow = strtoul(optarg, NULL, 0);
+            break;
+        case 'r':
+            rate_hz = strtod(optarg, NULL);
+            break;
+        case 'd':
+            seconds = strtod(optarg, NULL);
+            break;
+        case 'p':
+            port = (uint16_t)strtoul(optarg, NULL, 0);
+            break;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (count == 0 || count > HTTP_MAX_CLIENTS || slow > count || rate_hz <= 0)
+    {
+        usage(argv[0]);
+        printf("клиентов 1..%d, медленных не больше клиентов\n", HTTP_MAX_CLIENTS);
+        return 1;
+    }
+
+    // сокеты клиентов и сервера в одном процессе
+    struct rlimit files;
+    if (getrlimit(RLIMIT_NOFILE, &files) == 0 && files.rlim_cur < 2 * count + 64)
+    {
+        files.rlim_cur = files.rlim_max < 2 * count + 64 ? files.rlim_max : 2 * count + 64;
+        setrlimit(RLIMIT_NOFILE, &files);
+    }
+
+    static http_server server;
+    if (!http_server_start(&server, port, NULL, NULL, count))
+        return 1;
+
+    load_client *clients = calloc(count, sizeof(load_client));
+    struct pollfd *fds = calloc(count, sizeof(struct pollfd));
+    if (clients == NULL || fds == NULL)
+    {
+        printf("Error %i from calloc: %s\n", errno, strerror(errno));
+        return 1;
+    }
+
+    size_t connected = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        clients[i].slow = i < slow;
+        clients[i].first = true;
+        clients[i].fd = connect_client(port, clients[i].slow);
+        if (clients[i].fd < 0)
+            perror("connect");
+        else
+            connected++;
+    }
+
+    // публикация начинается, когда все клиенты получили заголовок потока
+    uint64_t slow_read_ms = 0;
+    uint64_t deadline = monotonic_ms() + 5000;
+    size_t streaming = 0;
+    while (streaming < connected && monotonic_ms() < deadline)
+    {
+        pump_clients(clients, count, fds, monotonic_ms() + 20, &slow_read_ms);
+        streaming = 0;
+        for (size_t i = 0; i < count; i++)
+            streaming += clients[i].fd >= 0 && clients[i].streaming;
+    }
+    printf("Подключено %zu из %zu клиентов (медленных %zu), поток открыт у %zu\n", connected, count, slow, streaming);
+
+    hwt905_epoch epoch;
+    memset(&epoch, 0, sizeof(epoch));
+    uint64_t published = 0;
+    uint64_t period_us = (uint64_t)(1e6 / rate_hz);
+    uint64_t start_ms = monotonic_ms();
+    uint64_t end_ms = start_ms + (uint64_t)(seconds * 1000);
+    uint64_t next_us = start_ms * 1000;
+
+    while (monotonic_ms() < end_ms)
+    {
+        epoch.seq = (uint32_t)published;
+        epoch.mask = 0x06;
+        for (int i = 0; i < 3; i++)
+        {
+            // длина события меняется от отсчета к отсчету, как у реальных данных
+            epoch.values.acceleration[i] = ((int)(published * 7919 + i * 104729) % 65536 - 32768) / 32768. * 156.8;
+            epoch.values.angularVelocity[i] = ((int)(published * 31 + i) % 65536 - 32768) / 32768. * 2000;
+        }
+        http_server_publish(&server, &epoch, next_us);
+        published++;
+        next_us += period_us;
+        pump_clients(clients, count, fds, next_us / 1000, &slow_read_ms);
+    }
+    double elapsed = (monotonic_ms() - start_ms) / 1000.;
+    // быстрые клиенты дочитывают последние события
+    pump_clients(clients, count, fds, monotonic_ms() + 500, &slow_read_ms);
+
+    uint64_t fast_events = 0, fast_gaps = 0, slow_events = 0, slow_gaps = 0, malformed = 0;
+    size_t closed = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        if (clients[i].slow)
+        {
+            slow_events += clients[i].events;
+            slow_gaps += clients[i].gaps;
+        }
+        else
+        {
+            fast_events += clients[i].events;
+            fast_gaps += clients[i].gaps;
+        }
+        malformed += clients[i].malformed;
+        closed += clients[i].fd < 0;
+    }
+
+    size_t fast = count - slow;
+    printf("Опубликовано %llu событий за %.1f с (%.0f Гц)\n", (unsigned long long)published, elapsed, published / elapsed);
+    printf("быстрые клиенты: принято в среднем %.1f, пропусков %llu\n",
+           fast ? (double)fast_events / fast : 0., (unsigned long long)fast_gaps);
+    printf("медленные клиенты: принято в среднем %.1f, пропусков в среднем %.1f\n",
+           slow ? (double)slow_events / slow : 0., slow ? (double)slow_gaps / slow : 0.);
+    printf("разорванных событий %llu, закрытых сервером соединений %zu\n", (unsigned long long)malformed, closed);
+
+    char report[256];
+    size_t len = http_server_format_stats(&server, report, sizeof(report));
+    char *line_end = memchr(report, '\n', len);
+    printf("%.*s\n", line_end ? (int)(line_end - report) : (int)len, report);  // только итоговая строка сервера
+
+    for (size_t i = 0; i < count; i++)
+    {
+        if (clients[i].fd >= 0)
+            close(clients[i].fd);
+    }
+    http_server_stop(&server);
+    free(clients);
+    free(fds);
+    return malformed != 0 || closed != 0 || streaming != count ? 1 : 0;
+}
@@ -0,0 +1,517 @@
+#define _GNU_SOURCE
+
+#include "http_stream.h"
+#include "text_encode.h"
+#include "stats.h"
+#include "spectrum.h"
+#include "rt.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+static volatile bool http_running = false;
+
+static const char stream_header[] =
+    "HTTP/1.1 200 OK\r\n"
+    "Content-Type: text/event-stream\r\n"
+    "Cache-Control: no-cache\r\n"
+    "Connection: close\r\n"
+    "Access-Control-Allow-Origin: *\r\n\r\n";
+
+static void close_client(http_server *server, http_client *client)
+{
+    close(client->fd);
+    client->fd = -1;
+    client->state = HTTP_CLIENT_FREE;
+    server->active_clients--;
+}
+
+/// @brief поставить ответ в очередь клиента
+static void queue_response(http_client *client, enum HTTP_CLIENT_STATE state, const char *data, size_t len)
+{
+    if (len > HTTP_CARRY_MAX)
+        len = HTTP_CARRY_MAX;
+    memcpy(client->carry, data, len);
+    client->carry_len = len;
+    client->carry_off = 0;
+    client->state = state;
+}
+
+/// @brief копирование события из общего буфера. Публикующий поток не ждет сервер и может перезаписать
+/// слот во время копирования, поэтому номер следующего события проверяется после копии
+/// @param server сервер
+/// @param id номер события
+/// @param dst буфер на HTTP_EVENT_MAX байт
+/// @param len длина скопированного события
+/// @return false, если слот перезаписан
+static bool copy_event(http_server *server, uint64_t id, char *dst, size_t *len)
+{
+    const http_event *event = &server->events[id % HTTP_EVENT_SLOTS];
+    size_t event_len = event->len < HTTP_EVENT_MAX ? event->len : HTTP_EVENT_MAX;
+
+    memcpy(dst, event->data, event_len);
+    atomic_thread_fence(memory_order_acquire);
+    if (atomic_load_explicit(&server->next_id, memory_order_relaxed) >= id + HTTP_EVENT_SLOTS)
+        return false;
+    *len = event_len;
+    return true;
+}
+
+/// @brief JSON последнего отсчета из общего буфера
+/// @return длина JSON, 0 - отсчетов нет или слот уже перезаписан
+static size_t copy_latest(http_server *server, char *json)
+{
+    char data[HTTP_EVENT_MAX];
+    size_t len;
+    uint64_t latest = atomic_load_explicit(&server->latest_id, memory_order_acquire);
+
+    if (latest == 0)
+        return 0;
+    const http_event *event = &server->events[(latest - 1) % HTTP_EVENT_SLOTS];
+    size_t json_off = event->json_off, json_len = event->json_len;
+    if (!copy_event(server, latest - 1, data, &len) || json_off + json_len > len)
+        return 0;
+    memcpy(json, data + json_off, json_len);
+    json[json_len] = '\0';
+    return json_len;
+}
+
+/// @brief разбор строки запроса, вызывается под server->lock
+static void handle_request(http_server *server, http_client *client)
+{
+    char response[HTTP_CARRY_MAX];
+    char latest[HTTP_EVENT_MAX];
+    size_t latest_len = 0;
+    char path[64] = "";
+    char method[8] = "";
+    int len;
+
+    sscanf(client->request, "%7s %63[^ ?]", method, path);
+
+    if (strcmp(method, "GET") != 0)
+    {
+        len = snprintf(response, sizeof(response),
+            "HTTP/1.1 405 Method Not Allowed\r\nAllow: GET\r\nContent-Length: 0\r\nConnection: close\r\n\r\n");
+        queue_response(client, HTTP_CLIENT_RESPONSE, response, len);
+    }
+    else if (strcmp(path, "/stream") == 0)
+    {
+        queue_response(client, HTTP_CLIENT_STREAM, stream_header, sizeof(stream_header) - 1);
+        client->next_event = atomic_load_explicit(&server->next_id, memory_order_acquire);
+    }
+    else if (strcmp(path, "/latest") == 0 && (latest_len = copy_latest(server, latest)) > 0)
+    {
+        len = snprintf(response, sizeof(response),
+            "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\nContent-Length: %zu\r\n"
+            "Cache-Control: no-cache\r\nAccess-Control-Allow-Origin: *\r\nConnection: close\r\n\r\n%s",
+            latest_len, latest);
+        queue_response(client, HTTP_CLIENT_RESPONSE, response, len);
+    }
+    else if (strcmp(path, "/latest") == 0)
+    {
+        len = snprintf(response, sizeof(response),
+            "HTTP/1.1 204 No Content\r\nConnection: close\r\n\r\n");
+        queue_response(client, HTTP_CLIENT_RESPONSE, response, len);
+    }
+    else if (strcmp(path, "/spectrum") == 0 && server->spectrum_fn != NULL)
+    {
+        char json[SPECTRUM_JSON_MAX];
+        size_t json_len = server->spectrum_fn(json, sizeof(json), server->spectrum_arg);
+
+        if (json_len == 0)
+            len = snprintf(response, sizeof(response), "HTTP/1.1 204 No Content\r\nConnection: close\r\n\r\n");
+        else
+            len = snprintf(response, sizeof(response),
+                "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\nContent-Length: %zu\r\n"
+                "Cache-Control: no-cache\r\nAccess-Control-Allow-Origin: *\r\nConnection: close\r\n\r\n%s",
+                json_len, json);
+        queue_response(client, HTTP_CLIENT_RESPONSE, response, len);
+    }
+    else
+    {
+        len = snprintf(response, sizeof(response),
+            "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\nConnection: close\r\n\r\n");
+        queue_response(client, HTTP_CLIENT_RESPONSE, response, len);
+    }
+}
+
+/// @brief прием данных от клиента
+/// @return false, если соединение закрыто
+static bool read_client(http_server *server, http_client *client)
+{
+    char discard[256];
+
+    while (true)
+    {
+        char *dst = discard;
+        size_t room = sizeof(discard);
+
+        if (client->state == HTTP_CLIENT_REQUEST)
+        {
+            dst = client->request + client->request_len;
+            room = HTTP_REQUEST_MAX - 1 - client->request_len;
+            if (room == 0)
+                return false;
+        }
+
+        ssize_t n = recv(client->fd, dst, room, MSG_DONTWAIT);
+        if (n == 0)
+            return false;
+        if (n < 0)
+            return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+
+        if (client->state == HTTP_CLIENT_REQUEST)
+        {
+            client->request_len += (size_t)n;
+            client->request[client->request_len] = '\0';
+            if (strstr(client->request, "\r\n\r\n") != NULL || strstr(client->request, "\n\n") != NULL)
+                handle_request(server, client);
+        }
+    }
+}
+
+/// @brief неблокирующая отправка клиенту: событие общего буфера копируется в carry и отправляется оттуда.
+/// Если клиент отстал больше чем на HTTP_EVENT_SLOTS событий, старые события для него пропускаются
+/// @return false, если соединение нужно закрыть
+static bool write_client(http_server *server, http_client *client)
+{
+    while (true)
+    {
+        if (client->carry_off < client->carry_len)
+        {
+            ssize_t n = send(client->fd, client->carry + client->carry_off,
+                             client->carry_len - client->carry_off, MSG_DONTWAIT | MSG_NOSIGNAL);
+            if (n < 0)
+                return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+            client->carry_off += (size_t)n;
+            if (client->carry_off < client->carry_len)
+                return true;
+            client->carry_len = client->carry_off = 0;
+            if (client->state == HTTP_CLIENT_RESPONSE)
+                return false;
+        }
+
+        uint64_t next_id = atomic_load_explicit(&server->next_id, memory_order_acquire);
+        if (client->state != HTTP_CLIENT_STREAM || client->next_event >= next_id)
+            return true;
+
+        if (next_id - client->next_event > HTTP_EVENT_SLOTS)
+        {
+            uint64_t skip = next_id - HTTP_EVENT_SLOTS - client->next_event;
+            client->dropped += skip;
+            server->events_dropped += skip;
+            client->next_event += skip;
+        }
+
+        // слот перезаписан во время копирования - событие для клиента пропущено
+        uint64_t id = client->next_event++;
+        if (!copy_event(server, id, client->carry, &client->carry_len))
+        {
+            client->dropped++;
+            server->events_dropped++;
+            continue;
+        }
+        client->carry_off = 0;
+        client->delivered++;
+        server->events_delivered++;
+    }
+}
+
+static void accept_clients(http_server *server)
+{
+    while (true)
+    {
+        int fd = accept4(server->listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0)
+            return;
+
+        http_client *client = NULL;
+        for (size_t i = 0; i < server->max_clients; i++)
+        {
+            if (server->clients[i].state == HTTP_CLIENT_FREE)
+            {
+                client = &server->clients[i];
+                break;
+            }
+        }
+        if (client == NULL)
+        {
+            close(fd);
+            continue;
+        }
+
+        // без ограничения ядро наращивает буфер отправки до мегабайтов, и медленный клиент
+        // получает секунды устаревших событий вместо пропуска в общем буфере
+        int sndbuf = HTTP_CLIENT_SNDBUF;
+        setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &sndbuf, sizeof(sndbuf));
+
+        client->fd = fd;
+        client->state = HTTP_CLIENT_REQUEST;
+        client->request_len = 0;
+        client->carry_len = client->carry_off = 0;
+        client->dropped = 0;
+        client->delivered = 0;
+        server->active_clients++;
+    }
+}
+
+static void* http_thread_function(void *arg)
+{
+    http_server *server = (http_server*) arg;
+    struct pollfd fds[HTTP_MAX_CLIENTS + 2];
+    http_client *owners[HTTP_MAX_CLIENTS + 2];
+
+    while (http_running)
+    {
+        size_t nfds = 2;
+        fds[0] = (struct pollfd) {server->listen_fd, POLLIN, 0};
+        fds[1] = (struct pollfd) {server->wake_pipe[0], POLLIN, 0};
+
+        pthread_mutex_lock(&server->lock);
+        for (size_t i = 0; i < server->max_clients; i++)
+        {
+            http_client *client = &server->clients[i];
+            if (client->state == HTTP_CLIENT_FREE)
+                continue;
+            short events = POLLIN;
+            if (client->carry_off < client->carry_len)
+                events |= POLLOUT;
+            owners[nfds] = client;
+            fds[nfds++] = (struct pollfd) {client->fd, events, 0};
+        }
+        pthread_mutex_unlock(&server->lock);
+
+        if (poll(fds, nfds, 1000) < 0 && errno != EINTR)
+            break;
+
+        if (fds[1].revents & POLLIN)
+        {
+            char drain[64];
+            while (read(server->wake_pipe[0], drain, sizeof(drain)) > 0)
+                ;
+        }
+
+        pthread_mutex_lock(&server->lock);
+        for (size_t i = 2; i < nfds; i++)
+        {
+            http_client *client = owners[i];
+            bool alive = !(fds[i].revents & (POLLERR | POLLNVAL));
+
+            if (alive && (fds[i].revents & (POLLIN | POLLHUP)))
+                alive = read_client(server, client);
+            if (alive)
+                alive = write_client(server, client);
+            if (!alive)
+                close_client(server, client);
+        }
+        if (fds[0].revents & POLLIN)
+            accept_clients(server);
+        pthread_mutex_unlock(&server->lock);
+    }
+    return NULL;
+}
+
+/// @brief запуск HTTP сервера в отдельном потоке
+/// @param server состояние сервера
+/// @param port порт
+/// @param clients массив состояний клиентов на max_clients элементов, если NULL - выделяется calloc
+/// @param events общий кольцевой буфер на HTTP_EVENT_SLOTS событий, если NULL - выделяется calloc
+/// @param max_clients максимальное число одновременных клиентов, не больше HTTP_MAX_CLIENTS
+/// @return true в случае успеха
+bool http_server_start(http_server *server, uint16_t port, http_client *clients, http_event *events, size_t max_clients)
+{
+    int opt = 1;
+    struct sockaddr_in address = {0};
+
+    memset(server, 0, sizeof(*server));
+    server->max_clients = max_clients < HTTP_MAX_CLIENTS ? max_clients : HTTP_MAX_CLIENTS;
+    server->clients = clients;
+    if (server->clients == NULL)
+        server->clients = (http_client*) calloc(server->max_clients, sizeof(http_client));
+    server->events = events;
+    if (server->events == NULL)
+        server->events = (http_event*) calloc(HTTP_EVENT_SLOTS, sizeof(http_event));
+    if (server->clients == NULL || server->events == NULL)
+    {
+        printf("Error %i from calloc: %s\n", errno, strerror(errno));
+        return false;
+    }
+    for (size_t i = 0; i < server->max_clients; i++)
+    {
+        server->clients[i].fd = -1;
+        server->clients[i].state = HTTP_CLIENT_FREE;
+    }
+
+    if ((server->listen_fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0)) < 0)
+    {
+        perror("socket failed");
+        return false;
+    }
+    setsockopt(server->listen_fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = INADDR_ANY;
+    address.sin_port = htons(port);
+    if (bind(server->listen_fd, (struct sockaddr *)&address, sizeof(address)) < 0 ||
+        listen(server->listen_fd, 128) < 0)
+    {
+        perror("HTTP bind/listen");
+        close(server->listen_fd);
+        return false;
+    }
+
+    if (pipe2(server->wake_pipe, O_NONBLOCK | O_CLOEXEC) < 0)
+    {
+        perror("pipe");
+        close(server->listen_fd);
+        return false;
+    }
+
+    // публикующие потоки (поток чтения, в том числе SCHED_FIFO, и поток триггера) делят только запись слота
+    pthread_mutexattr_t publish_attr;
+    pthread_mutexattr_init(&publish_attr);
+    pthread_mutexattr_setprotocol(&publish_attr, PTHREAD_PRIO_INHERIT);
+    pthread_mutex_init(&server->publish_lock, &publish_attr);
+    pthread_mutexattr_destroy(&publish_attr);
+    pthread_mutex_init(&server->lock, NULL);
+    http_running = true;
+    if (!rt_thread_create(&server->thread, HTTP_THREAD_STACK, http_thread_function, server))
+    {
+        printf("Error %i from pthread_create: %s\n", errno, strerror(errno));
+        http_running = false;
+        close(server->listen_fd);
+        return false;
+    }
+
+    printf("HTTP сервер слушает порт %d (GET /stream, GET /latest, GET /spectrum)\n", port);
+    return true;
+}
+
+_Static_assert(HTTP_EVENT_MAX >= TEXT_JSON_MAX + FMT_INT_MAX + 16, "HTTP_EVENT_MAX");
+_Static_assert(HTTP_CARRY_MAX >= SPECTRUM_JSON_MAX + 256, "HTTP_CARRY_MAX");
+
+/// @brief опубликовать отсчет всем HTTP клиентам. Событие кодируется один раз
+/// и хранится в общем кольцевом буфере, клиенты читают его по своему номеру события.
+/// Блокировка клиентов не берется, публикация не ждет сетевого ввода-вывода потока сервера
+/// @param server состояние сервера
+/// @param epoch запись цикла устройства
+/// @param ts_us время отсчета, микросекунды UTC
+void http_server_publish(http_server *server, const hwt905_epoch *epoch, uint64_t ts_us)
+{
+    pthread_mutex_lock(&server->publish_lock);
+    uint64_t id = atomic_load_explicit(&server->next_id, memory_order_relaxed);
+
+    // JSON кодируется сразу в слот кольцевого буфера, без промежуточной строки
+    http_event *event = &server->events[id % HTTP_EVENT_SLOTS];
+    char *p = event->data;
+    memcpy(p, "id: ", 4);
+    p += 4;
+    p += fmt_uint(p, epoch->seq);
+    memcpy(p, "\ndata: ", 7);
+    p += 7;
+    char *json = p;
+    size_t json_len = text_encode_json(json, epoch, ts_us);
+    p += json_len;
+    memcpy(p, "\n\n", 2);
+    p += 2;
+    event->id = id;
+    event->len = (size_t)(p - event->data);
+    event->json_off = (size_t)(json - event->data);
+    event->json_len = json_len;
+
+    atomic_store_explicit(&server->next_id, id + 1, memory_order_release);
+    atomic_store_explicit(&server->latest_id, id + 1, memory_order_release);
+    pthread_mutex_unlock(&server->publish_lock);
+
+    if (write(server->wake_pipe[1], "", 1) < 0 && errno != EAGAIN)
+        perror("HTTP wake");
+}
+
+/// @brief отправить всем клиентам /stream именованное событие SSE (например, смену частоты)
+/// @param server состояние сервера
+/// @param name имя события
+/// @param json данные события
+void http_server_event(http_server *server, const char *name, const char *json)
+{
+    pthread_mutex_lock(&server->publish_lock);
+    uint64_t id = atomic_load_explicit(&server->next_id, memory_order_relaxed);
+    http_event *event = &server->events[id % HTTP_EVENT_SLOTS];
+    int len = snprintf(event->data, sizeof(event->data), "event: %s\ndata: %s\n\n", name, json);
+    event->id = id;
+    event->len = (size_t)len < sizeof(event->data) ? (size_t)len : sizeof(event->data) - 1;
+    event->json_off = event->json_len = 0;
+    atomic_store_explicit(&server->next_id, id + 1, memory_order_release);
+    pthread_mutex_unlock(&server->publish_lock);
+
+    if (write(server->wake_pipe[1], "", 1) < 0 && errno != EAGAIN)
+        perror("HTTP wake");
+}
+
+/// @brief включить GET /spectrum
+/// @param server сервер
+/// @param spectrum_fn функция, которая пишет JSON последнего окна и возвращает его длину (0 - нет данных)
+/// @param arg аргумент функции
+void http_server_set_spectrum(http_server *server, http_json_fn spectrum_fn, void *arg)
+{
+    pthread_mutex_lock(&server->lock);
+    server->spectrum_fn = spectrum_fn;
+    server->spectrum_arg = arg;
+    pthread_mutex_unlock(&server->lock);
+}
+
+/// @brief отчет по событиям: всего и по каждому подключенному клиенту потока
+/// @param server сервер
+/// @param buf буфер отчета
+/// @param len размер буфера
+/// @return длина отчета
+size_t http_server_format_stats(http_server *server, char *buf, size_t len)
+{
+    size_t used;
+
+    pthread_mutex_lock(&server->lock);
+    used = stats_append(buf, len, 0, "HTTP: событий %llu, передано %llu, пропущено медленными клиентами %llu\n",
+        (unsigned long long)atomic_load(&server->next_id), (unsigned long long)server->events_delivered,
+        (unsigned long long)server->events_dropped);
+    for (size_t i = 0; i < server->max_clients; i++)
+    {
+        const http_client *client = &server->clients[i];
+        if (client->state != HTTP_CLIENT_STREAM)
+            continue;
+        used = stats_append(buf, len, used, "  клиент %d: передано %llu, пропущено %llu, следующее событие %llu\n",
+            client->fd, (unsigned long long)client->delivered, (unsigned long long)client->dropped,
+            (unsigned long long)client->next_event);
+    }
+    pthread_mutex_unlock(&server->lock);
+    return used;
+}
+
+/// @brief остановка потока сервера и закрытие всех соединений
+void http_server_stop(http_server *server)
+{
+    if (!http_running)
+        return;
+
+    http_running = false;
+    if (write(server->wake_pipe[1], "", 1) < 0 && errno != EAGAIN)
+        perror("HTTP wake");
+    pthread_join(server->thread, NULL);
+
+    for (size_t i = 0; i < server->max_clients; i++)
+    {
+        if (server->clients[i].state != HTTP_CLIENT_FREE)
+            close_client(server, &server->clients[i]);
+    }
+    close(server->listen_fd);
+    close(server->wake_pipe[0]);
+    close(server->wake_pipe[1]);
+    pthread_mutex_destroy(&server->lock);
+    pthread_mutex_destroy(&server->publish_lock);
+}
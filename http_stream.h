@@ -0,0 +1,87 @@
+#ifndef HTTP_STREAM_H
+#define HTTP_STREAM_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+#include "hwt905.h"
+#include "epoch.h"
+
+#define HTTP_DEFAULT_PORT 8081
+#define HTTP_MAX_CLIENTS 512
+#define HTTP_EVENT_SLOTS 64     // общий кольцевой буфер закодированных событий
+#define HTTP_EVENT_MAX 640      // максимальный размер одного события SSE
+#define HTTP_REQUEST_MAX 2048
+#define HTTP_CARRY_MAX 2048     // недописанный хвост ответа клиента, вмещает ответ /spectrum
+#define HTTP_CLIENT_SNDBUF 16384  // буфер отправки сокета клиента (ядро удваивает), около 0.3 с потока при 200 Гц
+#define HTTP_THREAD_STACK (64 * 1024) // стек потока сервера: pollfd и клиенты на HTTP_MAX_CLIENTS занимают около 13 КБ
+
+/// @brief закодированное событие SSE, общее для всех клиентов
+typedef struct
+{
+    uint64_t id;
+    size_t len;
+    size_t json_off;            // JSON отсчета внутри data для GET /latest
+    size_t json_len;
+    char data[HTTP_EVENT_MAX];
+} http_event;
+
+enum HTTP_CLIENT_STATE {
+    HTTP_CLIENT_FREE = 0,
+    HTTP_CLIENT_REQUEST,   // чтение запроса
+    HTTP_CLIENT_STREAM,    // GET /stream, отправка событий
+    HTTP_CLIENT_RESPONSE   // разовый ответ, после отправки соединение закрывается
+};
+
+/// @brief состояние клиента HTTP. Недописанная часть события копируется в carry,
+/// чтобы общий буфер событий мог перезаписываться независимо от медленных клиентов
+typedef struct
+{
+    int fd;
+    enum HTTP_CLIENT_STATE state;
+    char request[HTTP_REQUEST_MAX];
+    size_t request_len;
+    uint64_t next_event;
+    char carry[HTTP_CARRY_MAX];
+    size_t carry_len;
+    size_t carry_off;
+    uint64_t dropped;      // события, пропущенные из-за медленного чтения клиента
+    uint64_t delivered;    // события, переданные клиенту
+} http_client;
+
+typedef size_t (*http_json_fn)(char *buf, size_t len, void *arg);
+
+/// @brief HTTP/1.1 сервер: GET /stream - поток Server-Sent Events с JSON отсчетами,
+/// GET /latest - последний отсчет. Работает в отдельном потоке на poll с неблокирующей записью.
+/// Публикация не ждет клиентов: событие пишется в слот общего буфера и номер next_id увеличивается,
+/// поток сервера копирует событие и после копии проверяет, что слот не был перезаписан
+typedef struct
+{
+    int listen_fd;
+    int wake_pipe[2];
+    pthread_t thread;
+    pthread_mutex_t lock;       // клиенты и счетчики, поток сервера и отчет STATS
+    pthread_mutex_t publish_lock; // только между публикующими потоками, с наследованием приоритета
+    http_event *events;         // HTTP_EVENT_SLOTS событий
+    _Atomic uint64_t next_id;   // номер следующего события, увеличивается после записи слота
+    _Atomic uint64_t latest_id; // номер последнего отсчета + 1, 0 - отсчетов не было
+    http_client *clients;
+    size_t max_clients;
+    size_t active_clients;
+    uint64_t events_dropped;
+    uint64_t events_delivered;
+    http_json_fn spectrum_fn;   // GET /spectrum, NULL - спектр не включен
+    void *spectrum_arg;
+} http_server;
+
+bool http_server_start(http_server *server, uint16_t port, http_client *clients, http_event *events, size_t max_clients);
+void http_server_set_spectrum(http_server *server, http_json_fn spectrum_fn, void *arg);
+void http_server_publish(http_server *server, const hwt905_epoch *epoch, uint64_t ts_us);
+void http_server_event(http_server *server, const char *name, const char *json);
+size_t http_server_format_stats(http_server *server, char *buf, size_t len);
+void http_server_stop(http_server *server);
+
+#endif // HTTP_STREAM_H
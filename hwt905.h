@@ -70,7 +70,8 @@ enum REGISTERS {
     ANGULAR_VELONCY = 0x52,
     ANGLE = 0x53,
     MAGNETIC = 0x54,
-    QUATERION = 0x59
+    QUATERION = 0x59,
+    READ_REGISTER = 0x5F // ответ на чтение регистров
 };
 
 enum REQUEST_REGISTERS {
@@ -80,7 +81,9 @@ enum REQUEST_REGISTERS {
     ACCELERATION_REQ = 0x02,
     ANGULAR_VELONCY_REQ = 0x04,
     ANGLE_REQ = 0x08,
-    MAGNETIC_REQ = 0x10
+    MAGNETIC_REQ = 0x10,
+    QUATERION_REQ = 0x200,
+    READ_REGISTER_REQ = 0x27 // чтение регистра: FF AA 27 <регистр> 00
 };
 
 
@@ -97,9 +100,10 @@ typedef struct
     double angularVelocity[3];
     double temperature;
     float angle[3];
-    uint16_t magneta[3];
+    int16_t magneta[3];
     double quaterion[4];
     uint16_t version;
+    uint64_t timestamp_us; // время измерения, монотонные микросекунды (см. clock_align.h)
 }hwt905_values;
 
 #endif
\ No newline at end of file
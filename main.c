@@ -2,6 +2,22 @@
 #include "hwt905.h"
 #include "defines.h"
 #include "ports.h"
+#include "archive.h"
+#include "mcast.h"
+#include "http_stream.h"
+#include "rt.h"
+#include "clock_align.h"
+#include "epoch.h"
+#include "command_queue.h"
+#include "control.h"
+#include "arena.h"
+#include "trigger.h"
+#include "stats.h"
+#include "spectrum.h"
+
+#include <poll.h>
+
+#define SERIAL_READ_CHUNK 50  // байт за один read(), порт читается порциями до опустошения
 
 typedef struct 
 {
@@ -9,35 +25,41 @@ typedef struct
     uint32_t max_uart_delay;
     hwt905_values *values;
     size_t uart_buffer_read_len, uart_buffer_write_len;
-    struct headname *headp;   
+    command_queue *queue;
 }uart_args;
 
-struct command_elem
-{
-    uint8_t *command;
-    size_t bytes;
-    TAILQ_ENTRY(command_elem) entries;
-};
-
-TAILQ_HEAD(headname, command_elem);
 int serial_port;
 int server_fd, client_socket;
 uart_args uart_args_values;
 ringBuffer readRingBuffer;
+archive_writer archive;
+bool archive_enabled = false;
+mcast_publisher mcast;
+bool mcast_enabled = false;
+http_server http;
+bool http_enabled = false;
+rt_config rt;
+bool rt_enabled = false;
+jitter_recorder jitter;
+clock_align device_clock;
+epoch_assembler epochs;
+command_queue commands;
+control_channel control;
+bool control_enabled = false;
+const text_encoder *tcp_encoder = &text_encoder_human;
+arena memory;
+trigger_engine trigger;
+bool trigger_enabled = false;
+uint16_t subscribed_fields = 0; // кадры, которые нужны потребителям
+pipeline_stats stats;
+spectrum_analyzer spectrum;
+bool spectrum_enabled = false;
+bool dump_enabled = false; // отладочный вывод порций, кольцевого буфера и кадров
+volatile sig_atomic_t stop_requested = 0; // получен SIGTERM или SIGINT
 
 const float G = 9.8;
 
 
-void delete_command_elem(struct headname *headp) {
-	
-	struct command_elem *elem;
-	if (TAILQ_FIRST(headp)->command != NULL)
-		free(TAILQ_FIRST(headp)->command);
-	elem = TAILQ_FIRST(headp);
-	TAILQ_REMOVE(headp, TAILQ_FIRST(headp), entries);
-	free(elem);
-}
-
 /// @brief Функция открытвает порт для взаимодествия с HWT905
 /// @param path путь до порта
 /// @param serial_port номер порта
@@ -194,10 +216,11 @@ size_t msg_read_magnetic(uint8_t *const buffer, const size_t buffer_len)
 /// @param buffer текст полученного сообщения
 /// @param len длина полученного сообщения
 /// @param values список значений
-void parse_hwt905_answer(const uint8_t *const buffer, const size_t len, hwt905_values *values) 
+/// @return тип разобранного кадра (enum REGISTERS) или 0, если кадр не разобран
+uint8_t parse_hwt905_answer(const uint8_t *const buffer, const size_t len, hwt905_values *values) 
 {
 
-	uint8_t id;
+	uint8_t id = 0;
 	printf("\n-----------------------------------------\n");
 	switch (buffer[1]) 
     {
@@ -213,10 +236,12 @@ void parse_hwt905_answer(const uint8_t *const buffer, const size_t len, hwt905_v
         values->MM = buffer[3];
         values->DD = buffer[4];
         values->hh = buffer[5];
-        values->ss = buffer[6];
-        values->ms = (buffer[7] | (buffer[8] << 8));
-        printf("Текущее время:\n  Дата: %i:%i%i\n  Время: %i:%i:%i:%i\n", values->YY, values->MM, values->DD,
+        values->mm = buffer[6];
+        values->ss = buffer[7];
+        values->ms = (buffer[8] | (buffer[9] << 8));
+        printf("Текущее время:\n  Дата: %02i.%02i.%02i\n  Время: %i:%i:%i:%i\n", values->DD, values->MM, values->YY,
             values->hh, values->mm, values->ss, values->ms);
+		id = buffer[1];
 		break;
 	case ACCELERATION:
         //проверка контрольной суммы
@@ -225,12 +250,13 @@ void parse_hwt905_answer(const uint8_t *const buffer, const size_t len, hwt905_v
 			printf("\nНеверная контрольная сумма\n");
         	break;
 		}
-        values->acceleration[0] = ((buffer[3] << 8) | buffer[2]) / 32768. * 16 * G;
-        values->acceleration[1] = ((buffer[5] << 8) | buffer[4]) / 32768. * 16 * G;
-        values->acceleration[2] = ((buffer[7] << 8) | buffer[6]) / 32768. * 16 * G;
-        values->temperature = ((buffer[9] << 8 ) | buffer[8]) / 100.;
+        values->acceleration[0] = (int16_t)((buffer[3] << 8) | buffer[2]) / 32768. * 16 * G;
+        values->acceleration[1] = (int16_t)((buffer[5] << 8) | buffer[4]) / 32768. * 16 * G;
+        values->acceleration[2] = (int16_t)((buffer[7] << 8) | buffer[6]) / 32768. * 16 * G;
+        values->temperature = (int16_t)((buffer[9] << 8) | buffer[8]) / 100.;
         printf("Текущее ускорение объекта:\n  по оси X: %lf\n  по оси Y: %lf\n  по оси Z: %lf\n  полученная температура: %lf\n", 
             values->acceleration[0], values->acceleration[1], values->acceleration[2], values->temperature);
+		id = buffer[1];
 		break;
 	case ANGULAR_VELONCY:
         //проверка контрольной суммы
@@ -239,12 +265,13 @@ void parse_hwt905_answer(const uint8_t *const buffer, const size_t len, hwt905_v
 			printf("\nНеверная контрольная сумма\n");
         	break;
 		}
-        values->angularVelocity[0] = ((buffer[3] << 8) | buffer[2]) / 32768. * 2000;
-        values->angularVelocity[1] = ((buffer[5] << 8) | buffer[4]) / 32768. * 2000;
-        values->angularVelocity[2] = ((buffer[7] << 8) | buffer[6]) / 32768. * 2000;
-        values->temperature = ((buffer[9] << 8 ) | buffer[8]) / 100.;
+        values->angularVelocity[0] = (int16_t)((buffer[3] << 8) | buffer[2]) / 32768. * 2000;
+        values->angularVelocity[1] = (int16_t)((buffer[5] << 8) | buffer[4]) / 32768. * 2000;
+        values->angularVelocity[2] = (int16_t)((buffer[7] << 8) | buffer[6]) / 32768. * 2000;
+        values->temperature = (int16_t)((buffer[9] << 8) | buffer[8]) / 100.;
         printf("Текущая угловая скорость объекта:\n  по оси X: %lf\n  по оси Y: %lf\n  по оси Z: %lf\n  полученная температура: %lf\n", 
             values->angularVelocity[0], values->angularVelocity[1], values->angularVelocity[2], values->temperature);
+		id = buffer[1];
 		break;
 	case ANGLE:
 		//проверка контрольной суммы
@@ -253,12 +280,13 @@ void parse_hwt905_answer(const uint8_t *const buffer, const size_t len, hwt905_v
 			printf("\nНеверная контрольная сумма\n");
         	break;
 		}  
-        values->angle[0] = ((buffer[3] << 8) | buffer[2]) / 32768. * 180;
-        values->angle[1] = ((buffer[5] << 8) | buffer[4]) / 32768. * 180;
-        values->angle[2] = ((buffer[7] << 8) | buffer[6]) / 32768. * 180;
+        values->angle[0] = (int16_t)((buffer[3] << 8) | buffer[2]) / 32768. * 180;
+        values->angle[1] = (int16_t)((buffer[5] << 8) | buffer[4]) / 32768. * 180;
+        values->angle[2] = (int16_t)((buffer[7] << 8) | buffer[6]) / 32768. * 180;
         values->version = ((buffer[9] << 8 ) | buffer[8]);
         printf("Текущий угол поворота объекта:\n  по оси X: %lf\n  по оси Y: %lf\n  по оси Z: %lf\n  полученная версия(?): %i\n", 
             values->angle[0], values->angle[1], values->angle[2], values->version);
+		id = buffer[1];
 		break;
 	case MAGNETIC:
         //проверка контрольной суммы
@@ -267,12 +295,24 @@ void parse_hwt905_answer(const uint8_t *const buffer, const size_t len, hwt905_v
 			printf("\nНеверная контрольная сумма\n");
         	break;
 		}
-        values->magneta[0] = ((buffer[3] << 8) | buffer[2]);
-        values->magneta[1] = ((buffer[5] << 8) | buffer[4]);
-        values->magneta[2] = ((buffer[7] << 8) | buffer[6]);
+        values->magneta[0] = (int16_t)((buffer[3] << 8) | buffer[2]);
+        values->magneta[1] = (int16_t)((buffer[5] << 8) | buffer[4]);
+        values->magneta[2] = (int16_t)((buffer[7] << 8) | buffer[6]);
         //values->temperature = ((buffer[9] << 8 ) | buffer[8]) / 100.; // поему-то передается температура всегда 0
         printf("Текущая знчение магнитного поля (индукции):\n  по оси X: %i\n  по оси Y: %i\n  по оси Z: %i\n  полученная температура: %lf\n", 
             values->magneta[0], values->magneta[1], values->magneta[2], values->temperature);
+		id = buffer[1];
+		break;
+	case READ_REGISTER:
+        //проверка контрольной суммы
+        if(buffer[len-1] != crc_generate(buffer, len))
+        {
+			printf("\nНеверная контрольная сумма\n");
+        	break;
+		}
+        printf("Прочитаны регистры: %04X %04X %04X %04X\n", buffer[2] | (buffer[3] << 8), buffer[4] | (buffer[5] << 8),
+            buffer[6] | (buffer[7] << 8), buffer[8] | (buffer[9] << 8));
+		id = buffer[1];
 		break;
 	case QUATERION:
         //проверка контрольной суммы
@@ -281,18 +321,20 @@ void parse_hwt905_answer(const uint8_t *const buffer, const size_t len, hwt905_v
 			printf("\nНеверная контрольная сумма\n");
         	break;
 		}
-        values->quaterion[0] = ((buffer[3] << 8) | buffer[2]) / 32768.;
-        values->quaterion[1] = ((buffer[5] << 8) | buffer[4]) / 32768.;
-        values->quaterion[2] = ((buffer[7] << 8) | buffer[6]) / 32768.;
-        values->quaterion[3] = ((buffer[7] << 8) | buffer[6]) / 32768.;
+        values->quaterion[0] = (int16_t)((buffer[3] << 8) | buffer[2]) / 32768.;
+        values->quaterion[1] = (int16_t)((buffer[5] << 8) | buffer[4]) / 32768.;
+        values->quaterion[2] = (int16_t)((buffer[7] << 8) | buffer[6]) / 32768.;
+        values->quaterion[3] = (int16_t)((buffer[9] << 8) | buffer[8]) / 32768.;
         printf("Текущию кватерионы(?):\n  Кватерион 0: %lf\n  Кватерион 1: %lf\n  Кватерион 2: %lf\n  Кватерион (3): %lf\n", 
             values->quaterion[0], values->quaterion[1], values->quaterion[2], values->quaterion[3]);
+		id = buffer[1];
 		break;
 	default:
 		printf("Получена неизвестная комманда - ");
 		PRINTHEX8ARRAY(buffer, len);
 		printf("\n");
 	}
+	return id;
 }
 
 
@@ -304,13 +346,13 @@ void* uart_pthread_function(void *arg) {
 	uart_args *uart_args_values = (uart_args*) arg;
 	uint8_t *uart_buffer_read = NULL, *uart_buffer_write = NULL;
 
-	if ((uart_buffer_read = (uint8_t*) malloc(uart_args_values->uart_buffer_read_len)) < 0) {
+	if ((uart_buffer_read = (uint8_t*) malloc(uart_args_values->uart_buffer_read_len)) == NULL) {
 		
 		printf("Error %i from malloc: %s\n", errno, strerror(errno));
 		pthread_exit(NULL);
 	}
 	
-	if ((uart_buffer_write = (uint8_t*) malloc(uart_args_values->uart_buffer_write_len)) < 0) {
+	if ((uart_buffer_write = (uint8_t*) malloc(uart_args_values->uart_buffer_write_len)) == NULL) {
 		
 		printf("Error %i from malloc: %s\n", errno, strerror(errno));
         free(uart_buffer_read);
@@ -342,13 +384,13 @@ void* uart_pthread_function(void *arg) {
 					 uart_buffer_read, uart_args_values->uart_buffer_read_len,
 					 uart_args_values->max_uart_delay, uart_args_values->values);
 		
-		while (!TAILQ_EMPTY(uart_args_values->headp)) {
+		while (!TAILQ_EMPTY(&uart_args_values->queue->head)) {
 			
 			function_run(NULL, *uart_args_values->serial_port,
-						 TAILQ_FIRST(uart_args_values->headp)->command, TAILQ_FIRST(uart_args_values->headp)->bytes,
+						 TAILQ_FIRST(&uart_args_values->queue->head)->command, TAILQ_FIRST(&uart_args_values->queue->head)->bytes,
 						 uart_buffer_read, uart_args_values->uart_buffer_read_len,
 						 uart_args_values->max_uart_delay, uart_args_values->values);
-			delete_command_elem(uart_args_values->headp);
+			command_queue_drop_first(uart_args_values->queue);
 		}
 		
 		usleep(100*1000);
@@ -389,20 +431,72 @@ void function_run(size_t (*func)(uint8_t *const, const size_t), int serial_port,
 	}
 }
 
-void cleanup(int signaln)
+/// @brief отчет STATS: этапы от порта до сборки циклов и доставка каждому потребителю.
+/// Вызывается из потока канала управления и при завершении, значения снимаются без остановки чтения
+/// @param buf буфер отчета
+/// @param len размер буфера
+/// @return длина отчета
+size_t format_stats(char *buf, size_t len, void *arg)
 {
-	printf("Process hwt905 ending\n");
-	close(serial_port);
-	free(uart_args_values.values);
-	free(readRingBuffer.buffer);
+	(void) arg;
+	size_t used = stats_format(&stats, buf, len);
+
+	used = stats_append(buf, len, used, "TCP: отправлено %llu из %llu циклов, ошибок %llu\n",
+		(unsigned long long)stats_get(&stats.tcp_sent), (unsigned long long)stats_get(&stats.epochs),
+		(unsigned long long)stats_get(&stats.tcp_failed));
+	if (archive_enabled)
+		used = stats_append(buf, len, used, "архив: записано %llu, в блоке %llu, ошибок %llu\n",
+			(unsigned long long)stats_get(&stats.archive_written), (unsigned long long)stats_get(&stats.archive_pending),
+			(unsigned long long)stats_get(&stats.archive_failed));
+	if (mcast_enabled)
+		used = stats_append(buf, len, used, "multicast: отправлено %llu, потеряно при отправке %llu, в пакете %llu, "
+			"датаграмм %llu, ошибок %llu\n", (unsigned long long)stats_get(&stats.mcast_sent),
+			(unsigned long long)stats_get(&stats.mcast_failed), (unsigned long long)stats_get(&stats.mcast_pending),
+			(unsigned long long)stats_get(&stats.mcast_datagrams), (unsigned long long)stats_get(&stats.mcast_errors));
+	if (http_enabled && used + 1 < len)
+		used += http_server_format_stats(&http, buf + used, len - used);
+	if (trigger_enabled)
+		used = stats_append(buf, len, used, "триггер: событий %llu, не записано %llu\n",
+			(unsigned long long)stats_get(&stats.trigger_fired), (unsigned long long)stats_get(&stats.trigger_dropped));
+	return used;
+}
 
-	close(server_fd);
-	// close(client_socket);
+/// @brief снимок состояния потока чтения для format_stats, вызывается потоком чтения раз за проход
+void publish_stats(void)
+{
+	stats_set(&stats.ring_bytes, readRingBuffer.bytes_avail);
+	stats_set(&stats.assembler_frames, (uint64_t)__builtin_popcount(epochs.mask));
+	if (archive_enabled)
+	{
+		stats_set(&stats.archive_written, archive.samples_written);
+		stats_set(&stats.archive_pending, archive.pending_count);
+	}
+	if (mcast_enabled)
+	{
+		stats_set(&stats.mcast_sent, mcast.samples_sent);
+		stats_set(&stats.mcast_failed, mcast.samples_failed);
+		stats_set(&stats.mcast_pending, mcast.count);
+		stats_set(&stats.mcast_datagrams, mcast.datagrams_sent);
+		stats_set(&stats.mcast_errors, mcast.send_errors);
+	}
+	if (trigger_enabled)
+	{
+		stats_set(&stats.trigger_fired, trigger.fired);
+		stats_set(&stats.trigger_dropped, trigger.dropped);
+	}
+}
 
-	exit(0); // Завершаем программу
+/// @brief обработчик SIGTERM и SIGINT: только выставляет флаг, завершение выполняется в main после цикла чтения
+void cleanup(int signaln)
+{
+	stop_requested = 1;
 }
 
-bool find_msg_beginning(ringBuffer* ringBuffer)
+/// @brief пропуск байт до заголовка кадра 0x55
+/// @param ringBuffer кольцевой буфер
+/// @param skipped увеличивается на количество пропущенных байт
+/// @return true, если заголовок найден
+bool find_msg_beginning(ringBuffer* ringBuffer, uint64_t *skipped)
 {
 	for(size_t i =0; i < ringBuffer->bytes_avail; i++)
 	{
@@ -414,14 +508,121 @@ bool find_msg_beginning(ringBuffer* ringBuffer)
 		else
 		{
 			ringBuffer->bytes_avail -= i;
+			*skipped += i;
 			return true;
 		}
 	}
+	*skipped += ringBuffer->bytes_avail;
 	ringBuffer->bytes_avail = 0;
 	return false;	
 }
 
 
+/// @brief текущее время UTC в микросекундах
+uint64_t realtime_us(void)
+{
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return (uint64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+/// @brief отчеты спектра для канала управления и HTTP
+size_t spectrum_text(char *buf, size_t len, void *arg)
+{
+	return spectrum_format_text((spectrum_analyzer*) arg, buf, len);
+}
+
+size_t spectrum_json(char *buf, size_t len, void *arg)
+{
+	return spectrum_format_json((spectrum_analyzer*) arg, buf, len);
+}
+
+/// @brief отправка завершенного цикла устройства всем потребителям
+/// @param epoch запись цикла
+/// @param client_socket сокет TCP клиента
+void publish_epoch(hwt905_epoch *epoch, int client_socket)
+{
+	// кадры преобразуются один раз и только те, которые нужны включенным потребителям
+	epoch_decode(epoch, subscribed_fields);
+	stats_add(&stats.epochs, 1);
+	stats_add(&stats.epoch_frames, (uint64_t)__builtin_popcount(epoch->mask));
+
+	uint64_t sample_time = clock_align_to_realtime(&device_clock, epoch->values.timestamp_us);
+
+	if (archive_enabled)
+	{
+		archive_sample sample;
+		archive_sample_from_values(&sample, &epoch->values, sample_time);
+		if (!archive_write(&archive, &sample))
+			stats_add(&stats.archive_failed, 1);
+	}
+	if (mcast_enabled)
+		mcast_publish(&mcast, epoch, sample_time, monotonic_us());
+	if (http_enabled)
+		http_server_publish(&http, epoch, sample_time);
+
+	if (send_data(epoch, sample_time, tcp_encoder, client_socket))
+		stats_add(&stats.tcp_sent, 1);
+	else
+		stats_add(&stats.tcp_failed, 1);
+
+	if (spectrum_enabled)
+		spectrum_push(&spectrum, epoch, sample_time);
+
+	trigger_window window;
+	if (trigger_enabled && trigger_push(&trigger, epoch, sample_time, &window))
+		send_trigger(window.number, trigger.conditions[window.condition].text, window.trigger_seq,
+			(size_t)(window.end - window.first), client_socket);
+}
+
+/// @brief событие записано на диск: уведомление HTTP клиентов (вызывается из потока записи событий)
+void on_trigger_event(const trigger_event_info *info, void *arg)
+{
+	char json[192];
+	(void) arg;
+
+	printf("Событие %u (%s) записано: %zu отсчетов%s\n", info->number, info->condition, info->samples,
+		info->truncated ? ", окно обрезано" : "");
+	if (http_enabled)
+	{
+		snprintf(json, sizeof(json), "{\"event\":%u,\"condition\":\"%s\",\"trigger_seq\":%u,\"trigger_ts_us\":%llu,"
+			"\"samples\":%zu,\"file_offset\":%ld}", info->number, info->condition, info->trigger_seq,
+			(unsigned long long)info->trigger_ts_us, info->samples, info->file_offset);
+		http_server_event(&http, "trigger", json);
+	}
+}
+
+/// @brief применение подтвержденных устройством изменений из канала управления:
+/// новая частота сообщается клиентам, новое содержимое меняет ожидаемую маску цикла
+/// @param client_socket сокет TCP клиента
+void apply_control_changes(int client_socket)
+{
+	uint8_t rate_code;
+	uint16_t content_mask;
+
+	if (control_take_rate(&control, &rate_code))
+	{
+		double hz = hwt905_rate_hz(rate_code);
+		printf("Частота вывода изменена: %g Гц\n", hz);
+		send_rate(hz, client_socket);
+		if (mcast_enabled)
+			mcast.rate_dhz = (uint16_t)(hz * 10);
+		if (spectrum_enabled)
+			spectrum_set_rate(&spectrum, hz);
+		if (http_enabled)
+		{
+			char json[64];
+			snprintf(json, sizeof(json), "{\"rate_hz\":%g}", hz);
+			http_server_event(&http, "rate", json);
+		}
+	}
+	if (control_take_content(&control, &content_mask))
+	{
+		printf("Содержимое вывода изменено: 0x%03X\n", content_mask);
+		epochs.expected_mask = content_mask;
+	}
+}
+
 // Print system error and exit
 void error(char *msg)
 {
@@ -434,32 +635,186 @@ void error(char *msg)
 int main(int argc, char *argv[])
 {
 
-	 //привязываем к сигналам уничтожения и закрытия программы очистку памяти 
-    signal(SIGTERM, cleanup);
-    signal(SIGINT, cleanup);
+	// сигналы завершения прерывают ожидание (без SA_RESTART), цикл чтения заканчивается по флагу
+	struct sigaction stop_action;
+	memset(&stop_action, 0, sizeof(stop_action));
+	stop_action.sa_handler = cleanup;
+	sigemptyset(&stop_action.sa_mask);
+	sigaction(SIGTERM, &stop_action, NULL);
+	sigaction(SIGINT, &stop_action, NULL);
 	
     
-    struct headname headp;
+	char *control_path = NULL;
+	int load_threads = 0;
+	char *events_path = TRIGGER_DEFAULT_FILE;
+	char *archive_dir = NULL;
+	int http_port = 0;
 	
     char *path = "/dev/ttyUSB0"; //TODO исправить путь до порта 
     pthread_t uart_pthread;
 	ssize_t read_bytes;
+	int opt_char;
+	char mcast_group[64], mcast_iface[64];
+	uint16_t mcast_port;
 
+	trigger_init(&trigger);
+	spectrum_init(&spectrum);
+	while ((opt_char = getopt(argc, argv, "a:m:H:R:L:C:f:T:W:E:S:D")) != -1)
+	{
+		switch (opt_char)
+		{
+		case 'a': // каталог архива отсчетов
+			archive_dir = optarg;
+			archive_enabled = true;
+			break;
+		case 'm': // группа multicast group:port[@iface]
+			if (!mcast_parse_address(optarg, mcast_group, sizeof(mcast_group), &mcast_port, mcast_iface, sizeof(mcast_iface)) ||
+				!mcast_publisher_open(&mcast, mcast_group, mcast_port, mcast_iface))
+				exit(EXIT_FAILURE);
+			mcast_enabled = true;
+			break;
+		case 'H': // порт HTTP сервера (SSE)
+			http_port = atoi(optarg);
+			http_enabled = true;
+			break;
+		case 'R': // режим реального времени ядро:приоритет
+			if (!rt_parse_config(optarg, &rt))
+				exit(EXIT_FAILURE);
+			rt_enabled = true;
+			break;
+		case 'L': // синтетическая нагрузка на процессор, количество потоков
+			load_threads = atoi(optarg);
+			if (!rt_start_cpu_load(load_threads))
+				exit(EXIT_FAILURE);
+			break;
+		case 'C': // путь к Unix сокету канала управления
+			control_path = optarg;
+			break;
+		case 'f': // текстовый формат TCP клиента: human, csv, json, raw
+			if ((tcp_encoder = text_encoder_find(optarg)) == NULL)
+			{
+				printf("Неизвестный формат: %s (human, csv, json, raw)\n", optarg);
+				exit(EXIT_FAILURE);
+			}
+			break;
+		case 'T': // условие срабатывания: acc:<порог>, gyro:<порог>, expr:<выражение>
+			if (!trigger_add_condition(&trigger, optarg))
+				exit(EXIT_FAILURE);
+			trigger_enabled = true;
+			break;
+		case 'W': // окно события до_мс:после_мс
+			if (!trigger_parse_window(&trigger, optarg))
+				exit(EXIT_FAILURE);
+			break;
+		case 'E': // файл событий
+			events_path = optarg;
+			break;
+		case 'S': // спектр по осям, полосы нижняя-верхняя,... Гц или default
+			if (strcmp(optarg, "default") != 0 && !spectrum_parse_bands(&spectrum, optarg))
+				exit(EXIT_FAILURE);
+			spectrum_enabled = true;
+			break;
+		case 'D': // отладочный вывод считанных данных
+			dump_enabled = true;
+			break;
+		default:
+			printf("Использование: %s [-a каталог_архива] [-m группа:порт[@интерфейс]] [-H порт_http] "
+				   "[-R ядро:приоритет] [-L потоков_нагрузки] [-C сокет_управления] [-f human|csv|json|raw] "
+				   "[-T условие] [-W до_мс:после_мс] [-E файл_событий] [-S полосы_спектра|default] [-D]\n", argv[0]);
+			exit(EXIT_FAILURE);
+		}
+	}
 	
+	// вывод в терминал блокирует поток чтения на каждом кадре, в режиме реального времени он не допускается
+	if (dump_enabled && rt_enabled)
+	{
+		printf("Отладочный вывод (-D) в режиме реального времени отключен\n");
+		dump_enabled = false;
+	}
+
+	subscribed_fields = tcp_encoder->fields;
+	if (archive_enabled || mcast_enabled || http_enabled)
+		subscribed_fields |= EPOCH_DEFAULT_MASK;
+	if (trigger_enabled)
+		subscribed_fields |= trigger.fields;
+	if (spectrum_enabled)
+		subscribed_fields |= EPOCH_BIT(ACCELERATION) | EPOCH_BIT(ANGULAR_VELONCY);
+
 	readRingBuffer.buffer_size = 256;
 	readRingBuffer.bytes_avail = 0;
 	readRingBuffer.head = 0;
 	readRingBuffer.tail = 0;
-	readRingBuffer.buffer = (uint8_t*)malloc(readRingBuffer.buffer_size);
 
-    TAILQ_INIT(&headp);
+	// вся память времени работы выделяется одной ареной, размер зависит от включенных подсистем
+	arena_reserve(&memory, "кольцевой буфер", readRingBuffer.buffer_size);
+	arena_reserve(&memory, "значения", sizeof(hwt905_values));
+	arena_reserve(&memory, "пул команд", COMMAND_POOL_SIZE * sizeof(struct command_elem));
+	if (http_enabled)
+	{
+		arena_reserve(&memory, "клиенты HTTP", HTTP_MAX_CLIENTS * sizeof(http_client));
+		arena_reserve(&memory, "события HTTP", HTTP_EVENT_SLOTS * sizeof(http_event));
+	}
+	if (archive_enabled)
+	{
+		arena_reserve(&memory, "блок архива", ARCHIVE_CHUNK_MAX_BYTES);
+		arena_reserve(&memory, "отсчеты архива", ARCHIVE_CHUNK_SAMPLES * sizeof(archive_sample));
+	}
+	if (trigger_enabled)
+		arena_reserve(&memory, "история триггера", TRIGGER_HISTORY_SLOTS * sizeof(trigger_sample));
+	if (spectrum_enabled)
+		arena_reserve(&memory, "буферы спектра", sizeof(spectrum_buffers));
+	arena_account_static(&memory, "архив", sizeof(archive));
+	arena_account_static(&memory, "multicast", sizeof(mcast));
+	arena_account_static(&memory, "HTTP сервер", sizeof(http));
+	arena_account_static(&memory, "гистограмма", sizeof(jitter));
+	arena_account_static(&memory, "часы устройства", sizeof(device_clock));
+	arena_account_static(&memory, "канал управления", sizeof(control));
+	arena_account_static(&memory, "триггер", sizeof(trigger));
+	arena_account_static(&memory, "спектр", sizeof(spectrum));
+	// стеки вспомогательных потоков заданы явно: после mlockall (-R) они целиком находятся в ОЗУ
+	if (http_enabled)
+		arena_account_static(&memory, "стек HTTP", HTTP_THREAD_STACK);
+	if (control_path != NULL)
+		arena_account_static(&memory, "стек управления", CONTROL_THREAD_STACK);
+	if (trigger_enabled)
+		arena_account_static(&memory, "стек триггера", TRIGGER_THREAD_STACK);
+	if (load_threads > 0)
+		arena_account_static(&memory, "стеки нагрузки", (size_t)load_threads * RT_LOAD_STACK);
+	if (!arena_commit(&memory))
+		exit(EXIT_FAILURE);
+
+	readRingBuffer.buffer = (uint8_t*) arena_alloc(&memory, "кольцевой буфер", readRingBuffer.buffer_size);
+	uart_args_values.values = (hwt905_values*) arena_alloc(&memory, "значения", sizeof(hwt905_values));
+	struct command_elem *command_pool = (struct command_elem*) arena_alloc(&memory, "пул команд",
+		COMMAND_POOL_SIZE * sizeof(struct command_elem));
+	if (readRingBuffer.buffer == NULL || uart_args_values.values == NULL || command_pool == NULL ||
+		!command_queue_init(&commands, command_pool, COMMAND_POOL_SIZE))
+		exit(EXIT_FAILURE);
+
+	if (archive_enabled && !archive_writer_open(&archive, archive_dir,
+		(uint8_t*) arena_alloc(&memory, "блок архива", ARCHIVE_CHUNK_MAX_BYTES),
+		(archive_sample*) arena_alloc(&memory, "отсчеты архива", ARCHIVE_CHUNK_SAMPLES * sizeof(archive_sample))))
+		exit(EXIT_FAILURE);
+	if (http_enabled && !http_server_start(&http, (uint16_t)http_port,
+		(http_client*) arena_alloc(&memory, "клиенты HTTP", HTTP_MAX_CLIENTS * sizeof(http_client)),
+		(http_event*) arena_alloc(&memory, "события HTTP", HTTP_EVENT_SLOTS * sizeof(http_event)), HTTP_MAX_CLIENTS))
+		exit(EXIT_FAILURE);
+	if (spectrum_enabled && !spectrum_start(&spectrum,
+		(spectrum_buffers*) arena_alloc(&memory, "буферы спектра", sizeof(spectrum_buffers))))
+		exit(EXIT_FAILURE);
+	if (http_enabled && spectrum_enabled)
+		http_server_set_spectrum(&http, spectrum_json, &spectrum);
+	if (trigger_enabled && !trigger_start(&trigger, events_path,
+		(trigger_sample*) arena_alloc(&memory, "история триггера", TRIGGER_HISTORY_SLOTS * sizeof(trigger_sample)),
+		on_trigger_event, NULL))
+		exit(EXIT_FAILURE);
+	arena_report(&memory);
 	
 	uart_args_values.serial_port = &serial_port;
 	uart_args_values.uart_buffer_read_len = 11;
 	uart_args_values.uart_buffer_write_len = 30;
 	uart_args_values.max_uart_delay = 500;
-	uart_args_values.headp = &headp;
-	uart_args_values.values = (hwt905_values*) malloc(sizeof(hwt905_values));
+	uart_args_values.queue = &commands;
 	
 	
 	// создание shared memory
@@ -549,71 +904,165 @@ int main(int argc, char *argv[])
 
 	uint8_t parse_buffer[11];
 
+	if (control_path != NULL)
+	{
+		if (!control_start(&control, control_path, &commands, bandRate_cmd[3], readAll_cmd[3] | (readAll_cmd[4] << 8)))
+			exit(EXIT_FAILURE);
+		control_set_stats(&control, format_stats, NULL);
+		if (spectrum_enabled)
+			control_set_spectrum(&control, spectrum_text, &spectrum);
+		control_enabled = true;
+	}
+	if (mcast_enabled)
+		mcast.rate_dhz = (uint16_t)(hwt905_rate_hz(bandRate_cmd[3]) * 10);
+	if (spectrum_enabled)
+		spectrum_set_rate(&spectrum, hwt905_rate_hz(bandRate_cmd[3]));
+
+	jitter_init(&jitter);
+	clock_align_init(&device_clock);
+	uint64_t read_time = 0;
+	uint8_t frame_type;
+	enum FRAME_CHECK frame_result;
+	uint64_t resync_bytes = 0;
+	hwt905_epoch epoch;
+	epoch_init(&epochs, readAll_cmd[3] | (readAll_cmd[4] << 8));
+	if (rt_enabled)
+	{
+		// все буферы уже выделены: блокируем память и заранее обращаемся к страницам,
+		// после этого в цикле чтения нет ни выделений памяти, ни page fault
+		rt_prefault(memory.base, memory.size);
+		rt_prefault(buffer, sizeof(buffer));
+		rt_prefault_stack();
+		if (!rt_apply(&rt))
+			printf("Режим реального времени включен частично\n");
+	}
+
 	read_bytes = read(serial_port, buffer, 15);
 	PRINTHEX8ARRAY(buffer, read_bytes);
     
 
-	int count = 0;
-
 	// Принимаем новое подключение
 	if ((client_socket = accept(server_fd, (struct sockaddr *)&address, (socklen_t*)&addrlen)) < 0) {
         perror("accept");
     }
+	else if (tcp_encoder->header != NULL)
+		send(client_socket, tcp_encoder->header, strlen(tcp_encoder->header), MSG_NOSIGNAL);
+
+	// инициализация закончена, дальше память берется только из арены и статических структур
+	arena_seal();
 
 	//for(int i = 0; i < 1000; i++)
-	while (true) // TODO изменить бесконечный цикл???
+	while (!stop_requested)
 	{
 
-		read_bytes = read(serial_port, buffer, 50);
-		if(read_bytes != -1)
-		{	
-			printf("считанные данные:");
-			PRINTHEX8ARRAY(buffer, read_bytes);
+		// порт читается до опустошения: при полной загрузке канала за проход приходит больше
+		// одной порции, а кольцевой буфер разбирается после каждой
+		do
+		{
+			read_bytes = read(serial_port, buffer, SERIAL_READ_CHUNK);
+			read_time = monotonic_us();
+			if (read_bytes > 0)
+			{
+				// порция целиком или не помещается в кольцевой буфер, или помещается; потерянные байты учитываются
+				stats_add(&stats.chunks, 1);
+				stats_add(&stats.bytes_read, (uint64_t)read_bytes);
+				if (dump_enabled)
+				{
+					printf("считанные данные (порция %llu):", (unsigned long long)stats_get(&stats.chunks));
+					PRINTHEX8ARRAY(buffer, read_bytes);
+				}
+				if (!put(&readRingBuffer, buffer, (size_t)read_bytes))
+				{
+					stats_add(&stats.bytes_overflow, (uint64_t)read_bytes);
+					printf("Кольцевой буфер переполнен, потеряно %zd байт\n", read_bytes);
+				}
+			}
+			else if (read_bytes < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+			{
+				stats_add(&stats.read_errors, 1);
+				perror("Ошибка чтения порта");
+			}
+			if (dump_enabled)
+			{
+				printf("\nДанные, считанные в ринг буффер: ");
+				print_ring_buffer_hex(&readRingBuffer);
+			}
+
+			// разбираем все целые кадры, накопленные в кольцевом буфере
+			while (find_msg_beginning(&readRingBuffer, &resync_bytes) && get(&readRingBuffer, parse_buffer, 11))
+			{
+				stats_add(&stats.frames, 1);
+				// кадры одной порции read() имеют одно время прихода: интервал считается один раз на порцию,
+				// иначе каждый следующий кадр порции добавлял бы в гистограмму интервал 0 мкс
+				if (read_time != jitter.last_us)
+					jitter_record(&jitter, read_time);
+				if (dump_enabled)
+				{
+					printf("данные для парсинга (кадр %llu):", (unsigned long long)stats_get(&stats.frames));
+					PRINTHEX8ARRAY(parse_buffer, 11);
+					printf("\n");
+				}
+				// кадр только проверяется; в физические величины сразу переводится лишь TIME (нужен для часов),
+				// остальные кадры преобразуются лениво в publish_epoch
+				frame_type = hwt905_frame_check(parse_buffer, &frame_result);
+				if (frame_result == FRAME_CHECK_CRC)
+					stats_add(&stats.frames_crc, 1);
+				else if (frame_result != FRAME_CHECK_OK)
+					stats_add(&stats.frames_unknown, 1);
+				else if (frame_type == READ_REGISTER)
+					stats_add(&stats.frames_readback, 1);
+				else
+					stats_add(&stats.frames_data, 1);
+				if (frame_type == READ_REGISTER)
+				{
+					if (dump_enabled)
+						parse_hwt905_answer(parse_buffer, 11, uart_args_values.values);
+					if (control_enabled)
+						control_on_readback(&control, parse_buffer);
+				}
+
+				// время измерения: по кадру TIME через сопоставление часов устройства и хоста.
+				// Сборщик берет время цикла из его кадра TIME, а если TIME в цикле нет - из первого кадра,
+				// поэтому остальные кадры получают свое время прихода, приведенное к часам устройства
+				if (frame_type == TIME)
+				{
+					hwt905_decode_frame(parse_buffer, uart_args_values.values);
+					uint64_t device_ms = hwt905_device_time_ms(uart_args_values.values);
+					clock_align_update(&device_clock, device_ms, read_time);
+					uart_args_values.values->timestamp_us = clock_align_host_time(&device_clock, device_ms, read_time);
+				}
+				else if (frame_type != 0)
+					uart_args_values.values->timestamp_us = clock_align_extrapolate(&device_clock, read_time);
+
+				// клиентам уходит только завершенный цикл устройства, ровно один раз
+				if (epoch_push(&epochs, frame_type, parse_buffer, uart_args_values.values->timestamp_us, &epoch))
+					publish_epoch(&epoch, client_socket);
+			}
+			// пропущенные при поиске заголовка байты переносятся в общий счетчик один раз за проход
+			if (resync_bytes != 0)
+			{
+				stats_add(&stats.bytes_resync, resync_bytes);
+				resync_bytes = 0;
+			}
 		}
-		put(&readRingBuffer, buffer, read_bytes);
-		printf("\nДанные, считанные в ринг буффер: ");
-		find_msg_beginning(&readRingBuffer);
-		print_ring_buffer_hex(&readRingBuffer);
-		get(&readRingBuffer, parse_buffer, 11);
-		printf("данные для парсинга:");
-		PRINTHEX8ARRAY(parse_buffer, 11);
-		printf("\n");
-		parse_hwt905_answer(parse_buffer, 11, uart_args_values.values);
-		usleep(100*1000);
+		while (read_bytes == SERIAL_READ_CHUNK);
 
-		count += 1;
-		if(count % 10 == 0)
+		// команды канала управления уходят в порт между чтениями, поток данных не прерывается
+		command_queue_run(&commands, serial_port, monotonic_us());
+		if (control_enabled)
+			apply_control_changes(client_socket);
+
+		if (rt_enabled)
 		{
-							
-			char *cp;
-
-			// Critical section
-			time_t now = time(NULL);
-			cp = ctime(&now);
-			int len = strlen(cp);
-			if(*(cp + len -1) == '\n')
-				*(cp + len -1) = '\0';
-			// sprintf(shared_mem_ptr->buf, "%d: HWT905 message number = %i | date_time =  %s acceleration (%lf; %lf; %lf), MF (%i; %i; %i), Angular velocity (%lf;%lf;%lf), Temp = %lf\n", 
-			// 	getpid(),count / 10, cp, uart_args_values.values->acceleration[0], uart_args_values.values->acceleration[1], uart_args_values.values->acceleration[2],
-			// 	uart_args_values.values->magneta[0],uart_args_values.values->magneta[1], uart_args_values.values->magneta[2],
-			// 	uart_args_values.values->angularVelocity[0],  uart_args_values.values->angularVelocity[1],  uart_args_values.values->angularVelocity[2],
-			// 	uart_args_values.values->temperature);
-
-            // отправка сообщения по TCP 
-            // TODO реализовать отправку по TCPпапа
-
-			send_data(uart_args_values.values, client_socket);
-
-			printf("%d: Данные отправленные в shared memory HWT905 message number = %i | date_time =  %s acceleration (%lf; %lf; %lf), MF (%i; %i; %i), Angular velocity (%lf;%lf;%lf), Temp = %lf\n", 
-				getpid(),count, cp, uart_args_values.values->acceleration[0], uart_args_values.values->acceleration[1], uart_args_values.values->acceleration[2],
-				uart_args_values.values->magneta[0],uart_args_values.values->magneta[1], uart_args_values.values->magneta[2],
-				uart_args_values.values->angularVelocity[0],  uart_args_values.values->angularVelocity[1],  uart_args_values.values->angularVelocity[2],
-				uart_args_values.values->temperature);
-
-			// // Release mutex sem: V(mutex_sem)
-			// if(sem_post(mutex_sem) == -1)
-			// 	error("sem_post: mutex_sem");
+			// вместо опроса раз в 100 мс ждем данные порта, чтобы время прихода кадров не квантовалось
+			struct pollfd serial_poll = {serial_port, POLLIN, 0};
+			poll(&serial_poll, 1, 100);
 		}
+		else
+			usleep(100*1000);
+		if (mcast_enabled)
+			mcast_poll(&mcast, monotonic_us());
+		publish_stats();
 
 		// TODO тут будет проверка подключения клиента
 		
@@ -655,6 +1104,7 @@ int main(int argc, char *argv[])
 	
    	// pthread_join(uart_pthread, NULL);
 
+	printf("Process hwt905 ending\n");
 	printf("Последние актуальные данные по каждой позиции, полученные за время работы программы:\n ");
 	printf("Год: %i \n  Месяц: %i\n  День: %i\n  Время: %i:%i:%i:%i\n", uart_args_values.values->YY, uart_args_values.values->MM, uart_args_values.values->DD,
 	 	uart_args_values.values->hh, uart_args_values.values->mm, uart_args_values.values->ss, uart_args_values.values->ms);
@@ -664,11 +1114,27 @@ int main(int argc, char *argv[])
 	printf("Угол: (%lf, %lf, %lf)\n", uart_args_values.values->angle[0], uart_args_values.values->angle[1], uart_args_values.values->angle[2]);
 	printf("Магнитное поле: (%i, %i, %i)\n", uart_args_values.values->magneta[0], 
 		 uart_args_values.values->magneta[1], uart_args_values.values->magneta[2]);
-	printf("Кватерионы: (%lf, %lf, %lf, %lf)", uart_args_values.values->quaterion[0], uart_args_values.values->quaterion[1],
+	printf("Кватерионы: (%lf, %lf, %lf, %lf)\n", uart_args_values.values->quaterion[0], uart_args_values.values->quaterion[1],
 		 uart_args_values.values->quaterion[2], uart_args_values.values->quaterion[3]);
 
-	free(uart_args_values.values);
-	free(readRingBuffer.buffer);
+	if (archive_enabled)
+		archive_writer_close(&archive);
+	if (mcast_enabled)
+		mcast_publisher_close(&mcast);
+	// отчет собирается до остановки потоков: в него входят счетчики клиентов HTTP сервера
+	char report[CONTROL_REPLY_MAX];
+	publish_stats();
+	format_stats(report, sizeof(report), NULL);
+	if (trigger_enabled)
+		trigger_stop(&trigger);
+	if (http_enabled)
+		http_server_stop(&http);
+	if (control_enabled)
+		control_stop(&control);
+	jitter_print(&jitter);
+	printf("Уход часов устройства: %.1f ppm\n", clock_align_drift_ppm(&device_clock));
+	printf("Статистика конвейера:\n%s", report);
+	arena_free(&memory);
 	close(serial_port);
 	close(server_fd);
     return 0;
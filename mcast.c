@@ -0,0 +1,189 @@
+#include "mcast.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/socket.h>
+#include <arpa/inet.h>
+
+/// @brief разбор адреса вида group:port[@iface], например 239.255.90.5:8090@127.0.0.1
+/// @return true в случае успеха
+bool mcast_parse_address(const char *spec, char *group, size_t group_len, uint16_t *port, char *iface, size_t iface_len)
+{
+    const char *colon = strchr(spec, ':');
+    const char *at = strchr(spec, '@');
+    size_t len = colon ? (size_t)(colon - spec) : (at ? (size_t)(at - spec) : strlen(spec));
+
+    if (len == 0 || len >= group_len)
+        return false;
+    memcpy(group, spec, len);
+    group[len] = '\0';
+
+    *port = MCAST_DEFAULT_PORT;
+    if (colon)
+        *port = (uint16_t)strtoul(colon + 1, NULL, 10);
+
+    iface[0] = '\0';
+    if (at)
+        snprintf(iface, iface_len, "%s", at + 1);
+    return *port != 0;
+}
+
+/// @brief открыть сокет для отправки в группу multicast
+/// @param pub издатель
+/// @param group адрес группы
+/// @param port порт
+/// @param iface адрес интерфейса для отправки (127.0.0.1 для проверки на одной машине) или пустая строка
+/// @return true в случае успеха
+bool mcast_publisher_open(mcast_publisher *pub, const char *group, uint16_t port, const char *iface)
+{
+    unsigned char loop = 1, ttl = 1;
+
+    memset(pub, 0, sizeof(*pub));
+    pub->batch_max = MCAST_MAX_BATCH;
+    pub->max_delay_us = MCAST_DEFAULT_DELAY_US;
+
+    pub->group.sin_family = AF_INET;
+    pub->group.sin_port = htons(port);
+    if (inet_pton(AF_INET, group, &pub->group.sin_addr) != 1 || !IN_MULTICAST(ntohl(pub->group.sin_addr.s_addr)))
+    {
+        printf("Неверный адрес группы multicast: %s\n", group);
+        return false;
+    }
+
+    if ((pub->fd = socket(AF_INET, SOCK_DGRAM, 0)) < 0)
+    {
+        perror("socket failed");
+        return false;
+    }
+
+    setsockopt(pub->fd, IPPROTO_IP, IP_MULTICAST_LOOP, &loop, sizeof(loop));
+    setsockopt(pub->fd, IPPROTO_IP, IP_MULTICAST_TTL, &ttl, sizeof(ttl));
+
+    if (iface != NULL && iface[0] != '\0')
+    {
+        struct in_addr addr;
+        if (inet_pton(AF_INET, iface, &addr) != 1 ||
+            setsockopt(pub->fd, IPPROTO_IP, IP_MULTICAST_IF, &addr, sizeof(addr)) < 0)
+        {
+            perror("IP_MULTICAST_IF");
+            close(pub->fd);
+            return false;
+        }
+    }
+
+    printf("Отправка отсчетов в группу %s:%u\n", group, port);
+    return true;
+}
+
+/// @brief перевод записи цикла в компактный двоичный вид
+void mcast_sample_from_epoch(mcast_sample *sample, const hwt905_epoch *epoch, uint64_t ts_us)
+{
+    const hwt905_values *values = &epoch->values;
+
+    sample->seq = epoch->seq;
+    sample->ts_us = ts_us;
+    sample->mask = epoch->mask;
+    for (int i = 0; i < 3; i++)
+    {
+        sample->acceleration[i] = (float)values->acceleration[i];
+        sample->angularVelocity[i] = (float)values->angularVelocity[i];
+        sample->angle[i] = values->angle[i];
+        sample->magneta[i] = (int16_t)values->magneta[i];
+    }
+    for (int i = 0; i < 4; i++)
+        sample->quaterion[i] = (float)values->quaterion[i];
+    sample->temperature = (int16_t)(values->temperature * 100.);
+    sample->version = values->version;
+}
+
+/// @brief время UTC в микросекундах для заголовка датаграммы
+static uint64_t send_time_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/// @brief отправить накопленный пакет. В заголовок пишется время UTC в момент отправки
+/// @param pub издатель
+/// @return true, если пакет отправлен или отправлять нечего
+bool mcast_flush(mcast_publisher *pub)
+{
+    if (pub->count == 0)
+        return true;
+
+    mcast_header header = {MCAST_MAGIC, MCAST_VERSION, (uint16_t)pub->count, pub->rate_dhz, send_time_us()};
+    size_t len = sizeof(header) + pub->count * sizeof(mcast_sample);
+
+    memcpy(pub->datagram, &header, sizeof(header));
+    size_t count = pub->count;
+    pub->count = 0;
+
+    if (sendto(pub->fd, pub->datagram, len, MSG_DONTWAIT, (struct sockaddr*)&pub->group, sizeof(pub->group)) != (ssize_t)len)
+    {
+        pub->send_errors++;
+        pub->samples_failed += count;
+        return false;
+    }
+    pub->datagrams_sent++;
+    pub->samples_sent += count;
+    return true;
+}
+
+/// @brief добавить отсчет в пакет. Пакет отправляется сразу, если следующий отсчет
+/// (по сглаженному интервалу) не успеет прийти до истечения max_delay_us - при низкой
+/// частоте каждый отсчет уходит отдельной датаграммой, при высокой собираются пакеты
+/// @param pub издатель
+/// @param epoch запись цикла устройства
+/// @param ts_us время отсчета, микросекунды UTC
+/// @param now_us текущее монотонное время (monotonic_us), от него отсчитывается ожидание пакета
+/// @return false при ошибке отправки
+bool mcast_publish(mcast_publisher *pub, const hwt905_epoch *epoch, uint64_t ts_us, uint64_t now_us)
+{
+    if (pub->last_sample_us != 0 && ts_us > pub->last_sample_us)
+    {
+        uint64_t interval = ts_us - pub->last_sample_us;
+        if (interval > UINT32_MAX)
+            interval = UINT32_MAX;
+        pub->interval_us = pub->interval_us == 0 ? (uint32_t)interval
+                                                 : (uint32_t)((pub->interval_us * 7ull + interval) / 8);
+    }
+    pub->last_sample_us = ts_us;
+
+    if (pub->count == 0)
+        pub->batch_start_us = now_us;
+
+    mcast_sample sample;
+    mcast_sample_from_epoch(&sample, epoch, ts_us);
+    memcpy(pub->datagram + sizeof(mcast_header) + pub->count * sizeof(mcast_sample), &sample, sizeof(sample));
+    pub->count++;
+
+    uint64_t age = now_us - pub->batch_start_us;
+    if (pub->count >= pub->batch_max || pub->interval_us == 0 || age + pub->interval_us > pub->max_delay_us)
+        return mcast_flush(pub);
+    return true;
+}
+
+/// @brief отправить пакет, если старейший отсчет в нем ждет дольше max_delay_us.
+/// Вызывается периодически, чтобы последний пакет не задерживался, когда отсчеты перестают приходить
+/// @param now_us текущее монотонное время, те же часы, что в mcast_publish
+bool mcast_poll(mcast_publisher *pub, uint64_t now_us)
+{
+    if (pub->count > 0 && now_us - pub->batch_start_us >= pub->max_delay_us)
+        return mcast_flush(pub);
+    return true;
+}
+
+void mcast_publisher_close(mcast_publisher *pub)
+{
+    if (pub->fd > 0)
+    {
+        mcast_flush(pub);
+        close(pub->fd);
+    }
+    pub->fd = -1;
+}
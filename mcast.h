@@ -0,0 +1,74 @@
+#ifndef MCAST_H
+#define MCAST_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <netinet/in.h>
+
+#include "hwt905.h"
+#include "epoch.h"
+
+#define MCAST_MAGIC 0x314D5748u   // "HWM1"
+#define MCAST_VERSION 1
+#define MCAST_DEFAULT_GROUP "239.255.90.5"
+#define MCAST_DEFAULT_PORT 8090
+#define MCAST_MAX_PAYLOAD 1400     // без фрагментации IP в обычной сети
+#define MCAST_DEFAULT_DELAY_US 2000
+
+/// @brief заголовок датаграммы. Все поля little-endian
+typedef struct __attribute__((packed))
+{
+    uint32_t magic;
+    uint16_t version;
+    uint16_t count;      // количество отсчетов в датаграмме
+    uint16_t rate_dhz;   // частота вывода устройства, десятые доли Гц
+    uint64_t send_ts_us; // время отправки, микросекунды UTC
+} mcast_header;
+
+/// @brief запись цикла устройства в компактном двоичном виде, seq - номер цикла
+typedef struct __attribute__((packed))
+{
+    uint32_t seq;
+    uint64_t ts_us;
+    float acceleration[3];
+    float angularVelocity[3];
+    float angle[3];
+    float quaterion[4];
+    int16_t magneta[3];
+    int16_t temperature;  // сотые доли градуса
+    uint16_t version;
+    uint16_t mask;        // кадры, полученные в цикле (биты RSW)
+} mcast_sample;
+
+#define MCAST_MAX_BATCH ((MCAST_MAX_PAYLOAD - sizeof(mcast_header)) / sizeof(mcast_sample))
+
+/// @brief издатель отсчетов в группу UDP multicast. Отсчеты собираются в пакет,
+/// пока не будет набрано batch_max отсчетов или пока следующий отсчет не выйдет за max_delay_us
+typedef struct
+{
+    int fd;
+    struct sockaddr_in group;
+    uint16_t rate_dhz;
+    size_t batch_max;
+    uint32_t max_delay_us;
+    uint64_t batch_start_us;   // монотонное время прихода первого отсчета пакета
+    uint64_t last_sample_us;   // время последнего отсчета, для интервала между отсчетами
+    uint32_t interval_us;  // сглаженный интервал между отсчетами
+    size_t count;
+    uint8_t datagram[MCAST_MAX_PAYLOAD];
+    uint64_t datagrams_sent;
+    uint64_t send_errors;
+    uint64_t samples_sent;
+    uint64_t samples_failed;   // отсчеты в датаграммах, которые не удалось отправить
+} mcast_publisher;
+
+bool mcast_parse_address(const char *spec, char *group, size_t group_len, uint16_t *port, char *iface, size_t iface_len);
+bool mcast_publisher_open(mcast_publisher *pub, const char *group, uint16_t port, const char *iface);
+void mcast_sample_from_epoch(mcast_sample *sample, const hwt905_epoch *epoch, uint64_t ts_us);
+bool mcast_publish(mcast_publisher *pub, const hwt905_epoch *epoch, uint64_t ts_us, uint64_t now_us);
+bool mcast_flush(mcast_publisher *pub);
+bool mcast_poll(mcast_publisher *pub, uint64_t now_us);
+void mcast_publisher_close(mcast_publisher *pub);
+
+#endif // MCAST_H
@@ -0,0 +1,161 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <arpa/inet.h>
+
+#include "mcast.h"
+
+// Эталонный приемник отсчетов HWT905 из группы multicast.
+// mcast_receiver [group:port[@iface]] - раз в секунду выводит количество принятых отсчетов,
+// потери и повторы по порядковым номерам и задержку доставки (время приема - время отсчета).
+// Задержка имеет смысл только при синхронизированных часах (или на одной машине)
+
+static uint64_t realtime_us(void)
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (uint64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+typedef struct
+{
+    uint64_t received;
+    uint64_t datagrams;
+    uint64_t lost;
+    uint64_t duplicates;
+    int64_t latency_min;
+    int64_t latency_max;
+    int64_t latency_sum;
+} receiver_stats;
+
+static void reset_interval(receiver_stats *st)
+{
+    st->latency_min = INT64_MAX;
+    st->latency_max = INT64_MIN;
+    st->latency_sum = 0;
+}
+
+int main(int argc, char *argv[])
+{
+    char group[64] = MCAST_DEFAULT_GROUP, iface[64] = "";
+    uint16_t port = MCAST_DEFAULT_PORT;
+
+    if (argc > 1 && !mcast_parse_address(argv[1], group, sizeof(group), &port, iface, sizeof(iface)))
+    {
+        printf("Использование: %s [group:port[@iface]]\n", argv[0]);
+        return 1;
+    }
+
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd < 0)
+    {
+        perror("socket failed");
+        return 1;
+    }
+
+    int reuse = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+    struct sockaddr_in address = {0};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_ANY);
+    address.sin_port = htons(port);
+    if (bind(fd, (struct sockaddr*)&address, sizeof(address)) < 0)
+    {
+        perror("bind failed");
+        return 1;
+    }
+
+    struct ip_mreq mreq;
+    if (inet_pton(AF_INET, group, &mreq.imr_multiaddr) != 1)
+    {
+        printf("Неверный адрес группы: %s\n", group);
+        return 1;
+    }
+    mreq.imr_interface.s_addr = htonl(INADDR_ANY);
+    if (iface[0] != '\0')
+        inet_pton(AF_INET, iface, &mreq.imr_interface);
+    if (setsockopt(fd, IPPROTO_IP, IP_ADD_MEMBERSHIP, &mreq, sizeof(mreq)) < 0)
+    {
+        perror("IP_ADD_MEMBERSHIP");
+        return 1;
+    }
+
+    printf("Прием из группы %s:%u\n", group, port);
+
+    uint8_t datagram[MCAST_MAX_PAYLOAD];
+    receiver_stats st = {0};
+    uint32_t expected = 0;
+    bool first = true;
+    uint16_t rate_dhz = 0;
+    uint64_t interval_received = 0;
+    uint64_t report_at = realtime_us() + 1000000;
+
+    reset_interval(&st);
+
+    while (true)
+    {
+        ssize_t len = recv(fd, datagram, sizeof(datagram), 0);
+        uint64_t now = realtime_us();
+        mcast_header header;
+
+        if (len < (ssize_t)sizeof(header))
+            continue;
+        memcpy(&header, datagram, sizeof(header));
+        if (header.magic != MCAST_MAGIC || header.version != MCAST_VERSION ||
+            sizeof(header) + header.count * sizeof(mcast_sample) > (size_t)len)
+            continue;
+
+        st.datagrams++;
+        if (header.rate_dhz != rate_dhz)
+        {
+            rate_dhz = header.rate_dhz;
+            printf("частота вывода устройства: %.1f Гц\n", rate_dhz / 10.);
+        }
+        for (uint16_t i = 0; i < header.count; i++)
+        {
+            mcast_sample sample;
+            memcpy(&sample, datagram + sizeof(header) + i * sizeof(sample), sizeof(sample));
+
+            if (first || sample.seq == expected)
+            {
+                first = false;
+            }
+            else if ((int32_t)(sample.seq - expected) > 0)
+            {
+                st.lost += sample.seq - expected;
+            }
+            else
+            {
+                st.duplicates++;
+                continue;
+            }
+            expected = sample.seq + 1;
+
+            int64_t latency = (int64_t)(now - sample.ts_us);
+            if (latency < st.latency_min) st.latency_min = latency;
+            if (latency > st.latency_max) st.latency_max = latency;
+            st.latency_sum += latency;
+            st.received++;
+            interval_received++;
+        }
+
+        if (now >= report_at)
+        {
+            if (interval_received > 0)
+                printf("отсчетов: %llu (+%llu), датаграмм: %llu, потеряно: %llu, повторов: %llu, "
+                       "задержка мкс: мин %lld, средн %lld, макс %lld\n",
+                       (unsigned long long)st.received, (unsigned long long)interval_received,
+                       (unsigned long long)st.datagrams, (unsigned long long)st.lost,
+                       (unsigned long long)st.duplicates, (long long)st.latency_min,
+                       (long long)(st.latency_sum / (int64_t)interval_received), (long long)st.latency_max);
+            interval_received = 0;
+            reset_interval(&st);
+            report_at = now + 1000000;
+        }
+    }
+    return 0;
+}
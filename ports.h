@@ -10,12 +10,15 @@
 #include <arpa/inet.h>
 
 #include "hwt905.h"
+#include "epoch.h"
+#include "text_encode.h"
 
 #define PORT 8080  // Порт, на котором сервер будет принимать подключения
 
 
-void form_answer_buffer(char* buffer, size_t size, hwt905_values *data, int count);
-bool send_data( hwt905_values *data, int client_socket);
+bool send_data(const hwt905_epoch *epoch, uint64_t ts_us, const text_encoder *encoder, int client_socket);
+bool send_rate(double rate_hz, int client_socket);
+bool send_trigger(uint32_t number, const char *condition, uint32_t trigger_seq, size_t samples, int client_socket);
 bool start_TCP_server(int *server_fd, struct sockaddr_in *address, int *opt, int *adrlen);
 
 
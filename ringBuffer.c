@@ -54,6 +54,7 @@ bool get(ringBuffer *buffer, uint8_t *data, size_t size)
 
     buffer->head = (buffer->head + size) % buffer->buffer_size;
     buffer->bytes_avail -= size;
+    return true;
 }
 
 /// @brief Функиция, которая выводит кольцевой буфер в консоль
@@ -0,0 +1,241 @@
+#define _GNU_SOURCE
+
+#include "rt.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <math.h>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#include <sys/mman.h>
+
+/// @brief разбор параметров вида cpu:priority, например 2:80
+/// @return true в случае успеха
+bool rt_parse_config(const char *spec, rt_config *config)
+{
+    config->cpu = -1;
+    config->priority = 80;
+    config->lock_memory = true;
+
+    if (sscanf(spec, "%d:%d", &config->cpu, &config->priority) < 1)
+        return false;
+    return config->priority >= 1 && config->priority <= 99;
+}
+
+/// @brief перевод текущего потока в режим реального времени: привязка к ядру,
+/// SCHED_FIFO и блокировка всей памяти процесса в ОЗУ (mlockall)
+/// @param config параметры
+/// @return true, если все шаги выполнены
+bool rt_apply(const rt_config *config)
+{
+    bool ok = true;
+
+    if (config->cpu >= 0)
+    {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(config->cpu, &set);
+        int err = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+        if (err != 0)
+        {
+            printf("Ошибка привязки к ядру %d: %s\n", config->cpu, strerror(err));
+            ok = false;
+        }
+    }
+
+    struct sched_param param = {.sched_priority = config->priority};
+    int err = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+    if (err != 0)
+    {
+        printf("Ошибка установки SCHED_FIFO %d: %s\n", config->priority, strerror(err));
+        ok = false;
+    }
+
+    if (config->lock_memory && mlockall(MCL_CURRENT | MCL_FUTURE) != 0)
+    {
+        perror("mlockall");
+        ok = false;
+    }
+
+    if (ok)
+        printf("Режим реального времени: ядро %d, SCHED_FIFO %d\n", config->cpu, config->priority);
+    return ok;
+}
+
+/// @brief заранее обратиться ко всем страницам буфера, чтобы в цикле чтения не было page fault
+void rt_prefault(void *buffer, size_t len)
+{
+    volatile uint8_t *p = buffer;
+    for (size_t i = 0; i < len; i += 4096)
+        p[i] = p[i];
+    if (len > 0)
+        p[len - 1] = p[len - 1];
+}
+
+/// @brief заранее выделить страницы стека потока
+void rt_prefault_stack(void)
+{
+    volatile uint8_t stack[RT_STACK_PREFAULT];
+    memset((void*)stack, 0, sizeof(stack));
+}
+
+static void* cpu_load_function(void *arg)
+{
+    volatile uint64_t x = 0;
+    (void)arg;
+    while (true)
+        x++;
+    return NULL;
+}
+
+/// @brief запуск потока с явным размером стека. Стек по умолчанию (обычно 8 МБ) после mlockall
+/// целиком блокируется в ОЗУ, поэтому вспомогательные потоки создаются с небольшим стеком
+/// @param thread идентификатор потока
+/// @param stack_size размер стека, не меньше PTHREAD_STACK_MIN
+/// @param function функция потока
+/// @param arg аргумент функции
+/// @return true в случае успеха, иначе errno - код ошибки
+bool rt_thread_create(pthread_t *thread, size_t stack_size, void *(*function)(void*), void *arg)
+{
+    pthread_attr_t attr;
+    int err = pthread_attr_init(&attr);
+
+    if (err == 0)
+    {
+        if (stack_size < PTHREAD_STACK_MIN)
+            stack_size = PTHREAD_STACK_MIN;
+        err = pthread_attr_setstacksize(&attr, stack_size);
+        if (err == 0)
+            err = pthread_create(thread, &attr, function, arg);
+        pthread_attr_destroy(&attr);
+    }
+    errno = err;
+    return err == 0;
+}
+
+/// @brief синтетическая нагрузка на процессор для проверки джиттера: threads потоков с бесконечным циклом
+/// @return true в случае успеха
+bool rt_start_cpu_load(int threads)
+{
+    for (int i = 0; i < threads; i++)
+    {
+        pthread_t thread;
+        if (!rt_thread_create(&thread, RT_LOAD_STACK, cpu_load_function, NULL))
+        {
+            printf("Error %i from pthread_create: %s\n", errno, strerror(errno));
+            return false;
+        }
+        pthread_detach(thread);
+    }
+    printf("Запущена синтетическая нагрузка: %d потоков\n", threads);
+    return true;
+}
+
+uint64_t monotonic_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+void jitter_init(jitter_recorder *recorder)
+{
+    memset(recorder, 0, sizeof(*recorder));
+    recorder->min_us = UINT64_MAX;
+}
+
+/// @brief номер корзины: старшая степень двойки и три следующих бита
+static inline unsigned bucket_index(uint64_t value)
+{
+    if (value < JITTER_SUB_BUCKETS)
+        return (unsigned)value;
+
+    unsigned octave = 63 - __builtin_clzll(value);
+    unsigned sub = (unsigned)(value >> (octave - 3)) & (JITTER_SUB_BUCKETS - 1);
+    unsigned index = (octave - 2) * JITTER_SUB_BUCKETS + sub;
+    return index < JITTER_BUCKETS ? index : JITTER_BUCKETS - 1;
+}
+
+/// @brief нижняя граница корзины
+static inline uint64_t bucket_value(unsigned index)
+{
+    if (index < JITTER_SUB_BUCKETS)
+        return index;
+
+    unsigned octave = index / JITTER_SUB_BUCKETS + 2;
+    unsigned sub = index % JITTER_SUB_BUCKETS;
+    return ((uint64_t)(JITTER_SUB_BUCKETS + sub)) << (octave - 3);
+}
+
+/// @brief отметить приход кадра. Без выделения памяти, можно вызывать в цикле чтения
+/// @param recorder учет интервалов
+/// @param now_us время прихода, монотонные микросекунды
+void jitter_record(jitter_recorder *recorder, uint64_t now_us)
+{
+    if (recorder->last_us != 0 && now_us >= recorder->last_us)
+    {
+        uint64_t interval = now_us - recorder->last_us;
+
+        recorder->count++;
+        recorder->sum += (double)interval;
+        recorder->sum_sq += (double)interval * interval;
+        if (interval < recorder->min_us)
+            recorder->min_us = interval;
+        if (interval > recorder->max_us)
+            recorder->max_us = interval;
+        recorder->hist[bucket_index(interval)]++;
+    }
+    recorder->last_us = now_us;
+}
+
+/// @brief перцентиль интервала (верхняя граница корзины, не больше максимума), p от 0 до 1
+uint64_t jitter_percentile(const jitter_recorder *recorder, double p)
+{
+    uint64_t target = (uint64_t)ceil(p * recorder->count);
+    uint64_t seen = 0;
+
+    for (unsigned i = 0; i < JITTER_BUCKETS; i++)
+    {
+        seen += recorder->hist[i];
+        if (seen >= target && seen > 0)
+        {
+            uint64_t upper = i + 1 < JITTER_BUCKETS ? bucket_value(i + 1) : recorder->max_us;
+            return upper < recorder->max_us ? upper : recorder->max_us;
+        }
+    }
+    return recorder->max_us;
+}
+
+/// @brief вывод статистики интервалов и гистограммы в консоль
+void jitter_print(const jitter_recorder *recorder)
+{
+    if (recorder->count == 0)
+    {
+        printf("Интервалы между кадрами: нет данных\n");
+        return;
+    }
+
+    double mean = recorder->sum / recorder->count;
+    double variance = recorder->sum_sq / recorder->count - mean * mean;
+
+    printf("Интервалы между кадрами, мкс: %llu интервалов, мин %llu, средн %.1f, макс %llu, СКО %.1f\n",
+           (unsigned long long)recorder->count, (unsigned long long)recorder->min_us, mean,
+           (unsigned long long)recorder->max_us, variance > 0 ? sqrt(variance) : 0.);
+    printf("  p50 %llu, p99 %llu, p99.9 %llu\n",
+           (unsigned long long)jitter_percentile(recorder, 0.5),
+           (unsigned long long)jitter_percentile(recorder, 0.99),
+           (unsigned long long)jitter_percentile(recorder, 0.999));
+
+    for (unsigned i = 0; i < JITTER_BUCKETS; i++)
+    {
+        if (recorder->hist[i] == 0)
+            continue;
+        printf("  [%8llu, %8llu) %llu\n", (unsigned long long)bucket_value(i),
+               (unsigned long long)(i + 1 < JITTER_BUCKETS ? bucket_value(i + 1) : UINT64_MAX),
+               (unsigned long long)recorder->hist[i]);
+    }
+}
@@ -0,0 +1,51 @@
+#ifndef RT_H
+#define RT_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+#define RT_STACK_PREFAULT (256 * 1024)
+#define RT_LOAD_STACK (16 * 1024)   // стек потока синтетической нагрузки
+
+// гистограмма интервалов: 8 поддиапазонов на каждую степень двойки, от 1 мкс до ~2^31 мкс
+#define JITTER_SUB_BUCKETS 8
+#define JITTER_OCTAVES 32
+#define JITTER_BUCKETS (JITTER_SUB_BUCKETS * JITTER_OCTAVES)
+
+/// @brief параметры режима реального времени для потока чтения
+/// cpu - номер ядра для привязки (-1 - без привязки), priority - приоритет SCHED_FIFO (1..99)
+typedef struct
+{
+    int cpu;
+    int priority;
+    bool lock_memory;
+} rt_config;
+
+/// @brief учет интервалов между приходом кадров (мкс)
+typedef struct
+{
+    uint64_t last_us;
+    uint64_t count;
+    uint64_t min_us;
+    uint64_t max_us;
+    double sum;
+    double sum_sq;
+    uint64_t hist[JITTER_BUCKETS];
+} jitter_recorder;
+
+bool rt_parse_config(const char *spec, rt_config *config);
+bool rt_apply(const rt_config *config);
+void rt_prefault(void *buffer, size_t len);
+void rt_prefault_stack(void);
+bool rt_start_cpu_load(int threads);
+bool rt_thread_create(pthread_t *thread, size_t stack_size, void *(*function)(void*), void *arg);
+
+uint64_t monotonic_us(void);
+void jitter_init(jitter_recorder *recorder);
+void jitter_record(jitter_recorder *recorder, uint64_t now_us);
+uint64_t jitter_percentile(const jitter_recorder *recorder, double p);
+void jitter_print(const jitter_recorder *recorder);
+
+#endif // RT_H
@@ -0,0 +1,115 @@
+#include "sample.h"
+
+#include <string.h>
+
+/// @brief заполнить запись из сырых кадров цикла, без перевода в физические величины
+/// @param sample запись
+/// @param epoch цикл устройства
+/// @param timestamp_us время отсчета
+void hwt905_sample_from_epoch(hwt905_sample *sample, const hwt905_epoch *epoch, uint64_t timestamp_us)
+{
+    uint16_t available = epoch->mask & EPOCH_DEFAULT_MASK;
+    const uint8_t *frame;
+
+    memset(sample, 0, sizeof(*sample));
+    sample->timestamp_us = timestamp_us;
+    sample->seq = epoch->seq;
+    sample->mask = epoch->mask;
+    sample->available = available;
+
+    if (available & EPOCH_BIT(TIME))
+    {
+        frame = epoch->frames[TIME - TIME];
+        sample->YY = frame[2];
+        sample->MM = frame[3];
+        sample->DD = frame[4];
+        sample->hh = frame[5];
+        sample->mm = frame[6];
+        sample->ss = frame[7];
+        sample->ms = (uint16_t)hwt905_frame_word(frame, 3);
+    }
+    // температура берется из последнего по порядку кадра, как в epoch_decode
+    if (available & EPOCH_BIT(ACCELERATION))
+    {
+        frame = epoch->frames[ACCELERATION - TIME];
+        for (size_t i = 0; i < 3; i++)
+            sample->acc[i] = hwt905_frame_word(frame, i);
+        sample->temperature = hwt905_frame_word(frame, 3);
+    }
+    if (available & EPOCH_BIT(ANGULAR_VELONCY))
+    {
+        frame = epoch->frames[ANGULAR_VELONCY - TIME];
+        for (size_t i = 0; i < 3; i++)
+            sample->gyro[i] = hwt905_frame_word(frame, i);
+        sample->temperature = hwt905_frame_word(frame, 3);
+    }
+    if (available & EPOCH_BIT(ANGLE))
+    {
+        frame = epoch->frames[ANGLE - TIME];
+        for (size_t i = 0; i < 3; i++)
+            sample->angle[i] = hwt905_frame_word(frame, i);
+        sample->version = (uint16_t)hwt905_frame_word(frame, 3);
+    }
+    if (available & EPOCH_BIT(MAGNETIC))
+    {
+        frame = epoch->frames[MAGNETIC - TIME];
+        for (size_t i = 0; i < 3; i++)
+            sample->mag[i] = hwt905_frame_word(frame, i);
+    }
+    if (available & EPOCH_BIT(QUATERION))
+    {
+        frame = epoch->frames[QUATERION - TIME];
+        for (size_t i = 0; i < 4; i++)
+            sample->quat[i] = hwt905_frame_word(frame, i);
+    }
+}
+
+/// @brief перевод записи в физические величины. Результат совпадает с epoch_decode
+/// по тем же кадрам; поля отсутствующих кадров равны 0
+/// @param sample запись
+/// @param values значения
+void hwt905_sample_to_values(const hwt905_sample *sample, hwt905_values *values)
+{
+    memset(values, 0, sizeof(*values));
+    values->timestamp_us = sample->timestamp_us;
+
+    if (sample->available & EPOCH_BIT(TIME))
+    {
+        values->YY = sample->YY;
+        values->MM = sample->MM;
+        values->DD = sample->DD;
+        values->hh = sample->hh;
+        values->mm = sample->mm;
+        values->ss = sample->ss;
+        values->ms = sample->ms;
+    }
+    for (size_t i = 0; i < 3; i++)
+    {
+        if (sample->available & EPOCH_BIT(ACCELERATION))
+            values->acceleration[i] = hwt905_acc_from_raw(sample->acc[i]);
+        if (sample->available & EPOCH_BIT(ANGULAR_VELONCY))
+            values->angularVelocity[i] = hwt905_gyro_from_raw(sample->gyro[i]);
+        if (sample->available & EPOCH_BIT(ANGLE))
+            values->angle[i] = hwt905_angle_from_raw(sample->angle[i]);
+        values->magneta[i] = sample->mag[i];
+    }
+    if (sample->available & (EPOCH_BIT(ACCELERATION) | EPOCH_BIT(ANGULAR_VELONCY)))
+        values->temperature = hwt905_temp_from_raw(sample->temperature);
+    values->version = sample->version;
+    if (sample->available & EPOCH_BIT(QUATERION))
+    {
+        for (size_t i = 0; i < 4; i++)
+            values->quaterion[i] = hwt905_quat_from_raw(sample->quat[i]);
+    }
+}
+
+/// @brief цикл для текстовых кодировщиков: значения преобразованы, сырые кадры не восстанавливаются
+/// @param sample запись
+/// @param epoch цикл
+void hwt905_sample_to_epoch(const hwt905_sample *sample, hwt905_epoch *epoch)
+{
+    epoch->seq = sample->seq;
+    epoch->mask = sample->mask;
+    epoch->decoded = sample->available;
+    hwt905_sample_to_values(sample, &epoch->values);
+}
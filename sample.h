@@ -0,0 +1,37 @@
+#ifndef SAMPLE_H
+#define SAMPLE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "hwt905.h"
+#include "frame.h"
+#include "epoch.h"
+
+/// @brief компактная запись цикла: сырые значения кадров со знаком (int16, как их передает устройство),
+/// время и маски кадров. 60 байт данных, выровнена на строку кэша - ровно 64 байта.
+/// Физические величины получаются функциями hwt905_*_from_raw (frame.h) или hwt905_sample_to_values
+typedef struct
+{
+    uint64_t timestamp_us;
+    uint32_t seq;           // номер цикла
+    uint16_t mask;          // кадры, полученные в цикле (биты RSW)
+    uint16_t available;     // кадры цикла, значения которых есть в записи (mask & EPOCH_DEFAULT_MASK)
+    int16_t acc[3];
+    int16_t gyro[3];
+    int16_t angle[3];
+    int16_t mag[3];
+    int16_t quat[4];
+    int16_t temperature;    // сотые доли градуса, из последнего кадра ускорения или угловой скорости
+    uint16_t version;
+    uint16_t ms;
+    uint8_t YY, MM, DD, hh, mm, ss;
+} __attribute__((aligned(64))) hwt905_sample;
+
+_Static_assert(sizeof(hwt905_sample) == 64, "hwt905_sample занимает одну строку кэша");
+
+void hwt905_sample_from_epoch(hwt905_sample *sample, const hwt905_epoch *epoch, uint64_t timestamp_us);
+void hwt905_sample_to_values(const hwt905_sample *sample, hwt905_values *values);
+void hwt905_sample_to_epoch(const hwt905_sample *sample, hwt905_epoch *epoch);
+
+#endif // SAMPLE_H
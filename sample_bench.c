@@ -0,0 +1,199 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+
+#include "sample.h"
+
+// Проверка и замер компактной записи hwt905_sample.
+// sample_bench [-n циклов] - сначала циклы из случайных кадров переводятся в hwt905_sample и обратно,
+// значения сравниваются с epoch_decode (код возврата 1 при расхождении). Затем сравнивается прежний слот
+// истории триггера {ts_us, hwt905_epoch} с hwt905_sample: заполнение из цикла, копирование записи
+// в кольцо и проход по истории с чтением одного канала
+
+#define HISTORY 1024   // записей в кольце, как у истории триггера
+#define SCAN_ROUNDS 20000
+
+/// @brief прежний слот истории триггера
+typedef struct
+{
+    uint64_t ts_us;
+    hwt905_epoch epoch;
+} epoch_slot;
+
+static epoch_slot old_history[HISTORY];
+static hwt905_sample new_history[HISTORY];
+
+static double now_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void random_frame(uint8_t *frame, uint8_t type)
+{
+    uint8_t sum = 0;
+
+    frame[0] = START;
+    frame[1] = type;
+    for (int i = 2; i < HWT905_FRAME_LEN - 1; i++)
+        frame[i] = (uint8_t)rand();
+    for (int i = 0; i < HWT905_FRAME_LEN - 1; i++)
+        sum += frame[i];
+    frame[HWT905_FRAME_LEN - 1] = sum;
+}
+
+static bool values_equal(const hwt905_values *a, const hwt905_values *b)
+{
+    bool equal = a->YY == b->YY && a->MM == b->MM && a->DD == b->DD && a->hh == b->hh && a->mm == b->mm &&
+                 a->ss == b->ss && a->ms == b->ms && a->temperature == b->temperature &&
+                 a->version == b->version && a->timestamp_us == b->timestamp_us;
+
+    for (int i = 0; i < 3; i++)
+        equal = equal && a->acceleration[i] == b->acceleration[i] && a->angularVelocity[i] == b->angularVelocity[i] &&
+                a->angle[i] == b->angle[i] && a->magneta[i] == b->magneta[i];
+    for (int i = 0; i < 4; i++)
+        equal = equal && a->quaterion[i] == b->quaterion[i];
+    return equal;
+}
+
+/// @brief циклы из случайных кадров (иногда неполные и с лишними типами) через hwt905_sample
+/// @param last последний собранный цикл, для замеров
+/// @return количество расхождений
+static unsigned long check_round_trip(unsigned long frames, hwt905_epoch *last)
+{
+    epoch_assembler assembler;
+    hwt905_epoch epoch;
+    unsigned long epochs = 0, mismatches = 0;
+
+    srand(5);
+    epoch_init(&assembler, EPOCH_DEFAULT_MASK);
+    for (unsigned long k = 0; k < frames; k++)
+    {
+        uint8_t frame[HWT905_FRAME_LEN];
+        uint8_t type = TIME + rand() % 6;
+        if (rand() % 10 == 0)
+            type = TIME + rand() % FRAME_TYPES;
+        random_frame(frame, type);
+        if (!epoch_push(&assembler, type, frame, k, &epoch))
+            continue;
+
+        hwt905_epoch decoded = epoch;
+        hwt905_sample sample;
+        hwt905_values values;
+        epoch_decode(&decoded, EPOCH_DEFAULT_MASK);
+        hwt905_sample_from_epoch(&sample, &epoch, epoch.values.timestamp_us);
+        hwt905_sample_to_values(&sample, &values);
+        if (!values_equal(&decoded.values, &values) && mismatches++ < 10)
+            printf("цикл %u: значения после hwt905_sample не совпадают с epoch_decode\n", epoch.seq);
+        epochs++;
+        *last = epoch;
+    }
+    printf("Проверено циклов: %lu, расхождений: %lu\n", epochs, mismatches);
+    return mismatches;
+}
+
+static void benchmark(const hwt905_epoch *source, unsigned long count)
+{
+    hwt905_epoch epoch = *source;
+    double start, elapsed;
+    uint64_t sink = 0;
+
+    printf("Размер: hwt905_values %zu, слот {ts_us, hwt905_epoch} %zu, hwt905_sample %zu байт\n",
+           sizeof(hwt905_values), sizeof(epoch_slot), sizeof(hwt905_sample));
+
+    // заполнение: слот копирует цикл целиком, запись собирается из сырых слов кадров
+    start = now_seconds();
+    for (unsigned long i = 0; i < count; i++)
+    {
+        epoch.seq = (uint32_t)i;
+        old_history[i % HISTORY].ts_us = i;
+        old_history[i % HISTORY].epoch = epoch;
+        __asm__ volatile("" ::: "memory");
+    }
+    elapsed = now_seconds() - start;
+    printf("заполнение слота:      %6.1f нс\n", elapsed / count * 1e9);
+
+    start = now_seconds();
+    for (unsigned long i = 0; i < count; i++)
+    {
+        epoch.seq = (uint32_t)i;
+        hwt905_sample_from_epoch(&new_history[i % HISTORY], &epoch, i);
+        __asm__ volatile("" ::: "memory");
+    }
+    elapsed = now_seconds() - start;
+    printf("заполнение записи:     %6.1f нс\n", elapsed / count * 1e9);
+
+    // копирование готовой записи в кольцо (очередь между потоками)
+    epoch_slot slot = old_history[3];
+    start = now_seconds();
+    for (unsigned long i = 0; i < count; i++)
+    {
+        slot.ts_us = i;
+        old_history[i % HISTORY] = slot;
+        __asm__ volatile("" ::: "memory");
+    }
+    elapsed = now_seconds() - start;
+    printf("копирование слота:     %6.1f нс\n", elapsed / count * 1e9);
+
+    hwt905_sample sample = new_history[3];
+    start = now_seconds();
+    for (unsigned long i = 0; i < count; i++)
+    {
+        sample.seq = (uint32_t)i;
+        new_history[i % HISTORY] = sample;
+        __asm__ volatile("" ::: "memory");
+    }
+    elapsed = now_seconds() - start;
+    printf("копирование записи:    %6.1f нс\n", elapsed / count * 1e9);
+
+    // проход по истории: одно значение ускорения из каждой записи
+    double acc = 0;
+    start = now_seconds();
+    for (int r = 0; r < SCAN_ROUNDS; r++)
+    {
+        for (int i = 0; i < HISTORY; i++)
+            acc += old_history[i].epoch.values.acceleration[0];
+    }
+    elapsed = now_seconds() - start;
+    printf("проход по слотам:      %6.2f нс/запись\n", elapsed / SCAN_ROUNDS / HISTORY * 1e9);
+
+    long raw = 0;
+    start = now_seconds();
+    for (int r = 0; r < SCAN_ROUNDS; r++)
+    {
+        for (int i = 0; i < HISTORY; i++)
+            raw += new_history[i].acc[0];
+    }
+    elapsed = now_seconds() - start;
+    printf("проход по записям:     %6.2f нс/запись\n", elapsed / SCAN_ROUNDS / HISTORY * 1e9);
+
+    for (int i = 0; i < HISTORY; i++)
+        sink += old_history[i].ts_us + new_history[i].seq;
+    printf("(контрольные суммы %g %ld %llu)\n", acc, raw, (unsigned long long)sink);
+}
+
+int main(int argc, char *argv[])
+{
+    unsigned long count = 20000000;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "n:")) != -1)
+    {
+        if (opt != 'n')
+        {
+            printf("Использование: %s [-n циклов]\n", argv[0]);
+            return 1;
+        }
+        count = strtoul(optarg, NULL, 0);
+    }
+
+    hwt905_epoch last;
+    memset(&last, 0, sizeof(last));
+    if (check_round_trip(200000, &last) != 0)
+        return 1;
+    benchmark(&last, count);
+    return 0;
+}
@@ -0,0 +1,432 @@
+#include "spectrum.h"
+#include "stats.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+
+_Static_assert((SPECTRUM_N & (SPECTRUM_N - 1)) == 0, "SPECTRUM_N");
+
+static const char *const axis_names[SPECTRUM_AXES] = {"ax", "ay", "az", "gx", "gy", "gz"};
+
+/// @brief начальное состояние: полосы по умолчанию
+/// @param s анализатор
+void spectrum_init(spectrum_analyzer *s)
+{
+    memset(s, 0, sizeof(*s));
+    pthread_mutex_init(&s->lock, NULL);
+    spectrum_parse_bands(s, SPECTRUM_DEFAULT_BANDS);
+}
+
+/// @brief длина подпреобразований перед первым этапом radix-4: 2, если log2(SPECTRUM_HALF) нечетный
+/// (тогда первый этап radix-2), иначе 1
+static size_t first_quarter(void)
+{
+    size_t quarter = 1;
+    while (quarter * 4 <= SPECTRUM_HALF)
+        quarter *= 4;
+    return quarter == SPECTRUM_HALF ? 1 : 2;
+}
+
+/// @brief подключить буферы и посчитать таблицы БПФ
+/// @param s анализатор
+/// @param buffers таблицы и рабочие буферы, если NULL - выделяются calloc
+/// @return true в случае успеха
+bool spectrum_start(spectrum_analyzer *s, spectrum_buffers *buffers)
+{
+    s->buffers = buffers;
+    if (s->buffers == NULL)
+        s->buffers = (spectrum_buffers*) calloc(1, sizeof(spectrum_buffers));
+    if (s->buffers == NULL)
+    {
+        printf("Error %i from calloc: %s\n", errno, strerror(errno));
+        return false;
+    }
+    spectrum_buffers *b = s->buffers;
+    s->window_sum = s->window_power = 0;
+
+    // периодическое окно Ханна: при перекрытии 50% сумма соседних окон постоянна
+    for (size_t n = 0; n < SPECTRUM_N; n++)
+    {
+        b->window[n] = (float)(0.5 - 0.5 * cos(2. * M_PI * n / SPECTRUM_N));
+        s->window_sum += b->window[n];
+        s->window_power += b->window[n] * b->window[n];
+    }
+
+    // множители этапов radix-4 лежат подряд, по три на k: внутренний цикл БПФ читает их последовательно
+    spectrum_complex *w = b->twiddle;
+    for (size_t quarter = first_quarter(); 4 * quarter <= SPECTRUM_HALF; quarter *= 4)
+    {
+        for (size_t k = 0; k < quarter; k++)
+        {
+            for (size_t m = 1; m <= 3; m++)
+            {
+                double phase = -2. * M_PI * m * k / (4 * quarter);
+                *w++ = (spectrum_complex) {(float)cos(phase), (float)sin(phase)};
+            }
+        }
+    }
+    for (size_t k = 0; k < SPECTRUM_BINS; k++)
+    {
+        double phase = -2. * M_PI * k / SPECTRUM_N;
+        b->split[k] = (spectrum_complex) {(float)cos(phase), (float)sin(phase)};
+    }
+
+    size_t bits = 0;
+    while ((1u << bits) < SPECTRUM_HALF)
+        bits++;
+    for (size_t i = 0; i < SPECTRUM_HALF; i++)
+    {
+        size_t r = 0;
+        for (size_t b = 0; b < bits; b++)
+            r |= ((i >> b) & 1) << (bits - 1 - b);
+        b->bitrev[i] = (uint16_t)r;
+    }
+    return true;
+}
+
+/// @brief разбор полос "нижняя-верхняя,..." в Гц, например 0-5,5-20,20-100
+/// @return true в случае успеха
+bool spectrum_parse_bands(spectrum_analyzer *s, const char *spec)
+{
+    spectrum_band bands[SPECTRUM_BANDS_MAX];
+    size_t count = 0;
+    const char *p = spec;
+
+    while (*p != '\0')
+    {
+        float low, high;
+        int used = 0;
+
+        if (count == SPECTRUM_BANDS_MAX || sscanf(p, "%f-%f%n", &low, &high, &used) != 2 ||
+            low < 0 || high <= low || (p[used] != ',' && p[used] != '\0'))
+        {
+            printf("Неверные полосы спектра: %s (нижняя-верхняя,... Гц, не больше %d полос)\n", spec, SPECTRUM_BANDS_MAX);
+            return false;
+        }
+        bands[count++] = (spectrum_band) {low, high};
+        p += used;
+        if (*p == ',')
+            p++;
+    }
+    if (count == 0)
+    {
+        printf("Не заданы полосы спектра\n");
+        return false;
+    }
+
+    pthread_mutex_lock(&s->lock);
+    memcpy(s->bands, bands, sizeof(bands));
+    s->band_count = count;
+    s->result.valid = false;
+    pthread_mutex_unlock(&s->lock);
+    return true;
+}
+
+/// @brief задать частоту отсчетов. История сбрасывается: окна с разной частотой не смешиваются
+/// @param s анализатор
+/// @param rate_hz частота вывода устройства
+void spectrum_set_rate(spectrum_analyzer *s, double rate_hz)
+{
+    pthread_mutex_lock(&s->lock);
+    s->rate_hz = (float)rate_hz;
+    s->head = s->filled = s->since_window = 0;
+    s->result.valid = false;
+    pthread_mutex_unlock(&s->lock);
+}
+
+/// @brief комплексное БПФ длины SPECTRUM_HALF на месте: перестановка по таблице, этап radix-2
+/// при нечетном log2 длины, затем этапы radix-4 с прореживанием по времени
+static void fft(const spectrum_analyzer *s, spectrum_complex *z)
+{
+    for (size_t i = 0; i < SPECTRUM_HALF; i++)
+    {
+        size_t j = s->buffers->bitrev[i];
+        if (i < j)
+        {
+            spectrum_complex t = z[i];
+            z[i] = z[j];
+            z[j] = t;
+        }
+    }
+
+    size_t quarter = first_quarter();
+    if (quarter == 2)
+    {
+        for (size_t i = 0; i < SPECTRUM_HALF; i += 2)
+        {
+            spectrum_complex a = z[i], b = z[i + 1];
+            z[i] = (spectrum_complex) {a.re + b.re, a.im + b.im};
+            z[i + 1] = (spectrum_complex) {a.re - b.re, a.im - b.im};
+        }
+    }
+
+    // после перестановки блок из 4 * quarter содержит подряд преобразования отсчетов 4m, 4m + 2, 4m + 1, 4m + 3
+    const spectrum_complex *twiddle = s->buffers->twiddle;
+    for (; 4 * quarter <= SPECTRUM_HALF; quarter *= 4)
+    {
+        for (size_t start = 0; start < SPECTRUM_HALF; start += 4 * quarter)
+        {
+            spectrum_complex *x0 = &z[start];
+            spectrum_complex *x1 = x0 + quarter;
+            spectrum_complex *x2 = x1 + quarter;
+            spectrum_complex *x3 = x2 + quarter;
+            const spectrum_complex *w = twiddle;
+            for (size_t k = 0; k < quarter; k++, w += 3)
+            {
+                // a = A0, b = W^2k A1, c = W^k A2, d = W^3k A3
+                float a_re = x0[k].re, a_im = x0[k].im;
+                float b_re = x1[k].re * w[1].re - x1[k].im * w[1].im;
+                float b_im = x1[k].re * w[1].im + x1[k].im * w[1].re;
+                float c_re = x2[k].re * w[0].re - x2[k].im * w[0].im;
+                float c_im = x2[k].re * w[0].im + x2[k].im * w[0].re;
+                float d_re = x3[k].re * w[2].re - x3[k].im * w[2].im;
+                float d_im = x3[k].re * w[2].im + x3[k].im * w[2].re;
+
+                float s0_re = a_re + b_re, s0_im = a_im + b_im;
+                float s1_re = a_re - b_re, s1_im = a_im - b_im;
+                float s2_re = c_re + d_re, s2_im = c_im + d_im;
+                float s3_re = c_re - d_re, s3_im = c_im - d_im;
+
+                // X[k] = s0 + s2, X[k + 2q] = s0 - s2, X[k + q] = s1 - i s3, X[k + 3q] = s1 + i s3
+                x0[k] = (spectrum_complex) {s0_re + s2_re, s0_im + s2_im};
+                x2[k] = (spectrum_complex) {s0_re - s2_re, s0_im - s2_im};
+                x1[k] = (spectrum_complex) {s1_re + s3_im, s1_im - s3_re};
+                x3[k] = (spectrum_complex) {s1_re - s3_im, s1_im + s3_re};
+            }
+        }
+        twiddle += 3 * quarter;
+    }
+}
+
+/// @brief спектр мощности окна одной оси. Четные отсчеты идут в действительную часть,
+/// нечетные в мнимую; спектр действительного сигнала восстанавливается из БПФ половинной длины
+static void axis_power(spectrum_analyzer *s, const float *history)
+{
+    spectrum_complex *z = s->buffers->work;
+    const float *window = s->buffers->window;
+    float *power = s->buffers->power;
+    float mean = 0;
+
+    // постоянная составляющая (для ускорения - сила тяжести) вычитается до окна, чтобы не маскировать низкие частоты
+    for (size_t n = 0; n < SPECTRUM_N; n++)
+        mean += history[n];
+    mean /= SPECTRUM_N;
+
+    for (size_t n = 0; n < SPECTRUM_HALF; n++)
+    {
+        size_t even = (s->head + 2 * n) & (SPECTRUM_N - 1);
+        size_t odd = (s->head + 2 * n + 1) & (SPECTRUM_N - 1);
+        z[n].re = (history[even] - mean) * window[2 * n];
+        z[n].im = (history[odd] - mean) * window[2 * n + 1];
+    }
+    fft(s, z);
+
+    for (size_t k = 0; k < SPECTRUM_BINS; k++)
+    {
+        spectrum_complex a = z[k & (SPECTRUM_HALF - 1)];
+        spectrum_complex b = z[(SPECTRUM_HALF - k) & (SPECTRUM_HALF - 1)];
+        // четная часть (a + conj(b)) / 2, нечетная (a - conj(b)) / 2i
+        float even_re = 0.5f * (a.re + b.re), even_im = 0.5f * (a.im - b.im);
+        float odd_re = 0.5f * (a.im + b.im), odd_im = -0.5f * (a.re - b.re);
+        const spectrum_complex *w = &s->buffers->split[k];
+        float re = even_re + odd_re * w->re - odd_im * w->im;
+        float im = even_im + odd_re * w->im + odd_im * w->re;
+        power[k] = re * re + im * im;
+    }
+}
+
+/// @brief СКЗ в полосах: по равенству Парсеваля с поправкой на мощность окна
+static void axis_bands(const spectrum_analyzer *s, float *rms)
+{
+    float bin_hz = s->rate_hz / SPECTRUM_N;
+    float scale = 1.f / (SPECTRUM_N * s->window_power);
+    const float *power = s->buffers->power;
+
+    for (size_t b = 0; b < s->band_count; b++)
+    {
+        size_t first = (size_t)ceilf(s->bands[b].low_hz / bin_hz);
+        size_t last = (size_t)ceilf(s->bands[b].high_hz / bin_hz);
+        float sum = 0;
+
+        if (last > SPECTRUM_BINS)
+            last = SPECTRUM_BINS;
+        for (size_t k = first; k < last; k++)
+            sum += (k == 0 || k == SPECTRUM_HALF) ? power[k] : 2 * power[k];
+        rms[b] = sqrtf(sum * scale);
+    }
+}
+
+/// @brief наибольшие локальные максимумы спектра без постоянной составляющей.
+/// Частота и амплитуда уточняются параболой по логарифму мощности трех соседних бинов
+static void axis_peaks(const spectrum_analyzer *s, spectrum_peak *peaks)
+{
+    float best[SPECTRUM_PEAKS];
+    size_t best_bin[SPECTRUM_PEAKS];
+    size_t found = 0;
+    const float *power = s->buffers->power;
+
+    for (size_t k = 1; k < SPECTRUM_HALF; k++)
+    {
+        float p = power[k];
+        if (p <= power[k - 1] || p < power[k + 1])
+            continue;
+
+        size_t pos = found < SPECTRUM_PEAKS ? found++ : SPECTRUM_PEAKS;
+        while (pos > 0 && best[pos - 1] < p)
+        {
+            if (pos < SPECTRUM_PEAKS)
+            {
+                best[pos] = best[pos - 1];
+                best_bin[pos] = best_bin[pos - 1];
+            }
+            pos--;
+        }
+        if (pos < SPECTRUM_PEAKS)
+        {
+            best[pos] = p;
+            best_bin[pos] = k;
+        }
+    }
+
+    for (size_t i = 0; i < SPECTRUM_PEAKS; i++)
+    {
+        if (i >= found)
+        {
+            peaks[i] = (spectrum_peak) {0, 0};
+            continue;
+        }
+        size_t k = best_bin[i];
+        float alpha = logf(power[k - 1] + 1e-30f);
+        float beta = logf(power[k] + 1e-30f);
+        float gamma = logf(power[k + 1] + 1e-30f);
+        float denominator = alpha - 2 * beta + gamma;
+        float delta = denominator < 0 ? 0.5f * (alpha - gamma) / denominator : 0;
+        float log_power = beta - 0.25f * (alpha - gamma) * delta;
+
+        peaks[i].hz = (k + delta) * s->rate_hz / SPECTRUM_N;
+        // синусоида амплитуды A дает в бине |X| = A * sum(w) / 2
+        peaks[i].amplitude = 2 * sqrtf(expf(log_power)) / s->window_sum;
+    }
+}
+
+/// @brief добавить цикл. Каждые SPECTRUM_HOP отсчетов после заполнения окна считаются спектры всех осей
+/// @param s анализатор
+/// @param epoch цикл с преобразованными кадрами ускорения и угловой скорости
+/// @param ts_us время отсчета
+/// @return true, если посчитано новое окно
+bool spectrum_push(spectrum_analyzer *s, const hwt905_epoch *epoch, uint64_t ts_us)
+{
+    const hwt905_values *v = &epoch->values;
+    spectrum_result result;
+
+    if (s->rate_hz <= 0 || s->buffers == NULL)
+        return false;
+
+    // окно - равномерная последовательность отсчетов: цикл без ускорения или угловой скорости
+    // (неполный цикл, SET CONTENT без них) не пропускается молча, а начинает окно заново
+    const uint16_t needed = EPOCH_BIT(ACCELERATION) | EPOCH_BIT(ANGULAR_VELONCY);
+    if ((epoch->mask & needed) != needed)
+    {
+        s->head = s->filled = s->since_window = 0;
+        return false;
+    }
+
+    for (size_t axis = 0; axis < 3; axis++)
+    {
+        s->buffers->history[axis][s->head] = (float)v->acceleration[axis];
+        s->buffers->history[3 + axis][s->head] = (float)v->angularVelocity[axis];
+    }
+    s->head = (s->head + 1) & (SPECTRUM_N - 1);
+    if (s->filled < SPECTRUM_N)
+        s->filled++;
+    if (s->filled < SPECTRUM_N || ++s->since_window < SPECTRUM_HOP)
+        return false;
+    s->since_window = 0;
+
+    result.valid = true;
+    result.seq = epoch->seq;
+    result.ts_us = ts_us;
+    result.windows = s->result.windows + 1;
+    result.rate_hz = s->rate_hz;
+    for (size_t axis = 0; axis < SPECTRUM_AXES; axis++)
+    {
+        axis_power(s, s->buffers->history[axis]);
+        axis_bands(s, result.rms[axis]);
+        axis_peaks(s, result.peaks[axis]);
+    }
+
+    pthread_mutex_lock(&s->lock);
+    s->result = result;
+    pthread_mutex_unlock(&s->lock);
+    return true;
+}
+
+/// @brief последнее окно текстом для канала управления
+/// @return длина текста, 0 - окно еще не посчитано
+size_t spectrum_format_text(spectrum_analyzer *s, char *buf, size_t len)
+{
+    size_t used;
+
+    pthread_mutex_lock(&s->lock);
+    const spectrum_result *r = &s->result;
+    if (!r->valid)
+    {
+        pthread_mutex_unlock(&s->lock);
+        return 0;
+    }
+    used = stats_append(buf, len, 0, "окно %d отсчетов, %g Гц, цикл %u, окон %llu\nполосы, Гц:",
+        SPECTRUM_N, r->rate_hz, r->seq, (unsigned long long)r->windows);
+    for (size_t b = 0; b < s->band_count; b++)
+        used = stats_append(buf, len, used, " %g-%g", s->bands[b].low_hz, s->bands[b].high_hz);
+    used = stats_append(buf, len, used, "\n");
+    for (size_t axis = 0; axis < SPECTRUM_AXES; axis++)
+    {
+        used = stats_append(buf, len, used, "%s СКЗ:", axis_names[axis]);
+        for (size_t b = 0; b < s->band_count; b++)
+            used = stats_append(buf, len, used, " %.4g", r->rms[axis][b]);
+        used = stats_append(buf, len, used, " | пики:");
+        for (size_t i = 0; i < SPECTRUM_PEAKS && r->peaks[axis][i].hz > 0; i++)
+            used = stats_append(buf, len, used, " %.2f Гц %.4g", r->peaks[axis][i].hz, r->peaks[axis][i].amplitude);
+        used = stats_append(buf, len, used, "\n");
+    }
+    pthread_mutex_unlock(&s->lock);
+    return used;
+}
+
+/// @brief последнее окно в JSON для HTTP:
+/// {"seq":..,"ts_us":..,"rate_hz":..,"n":256,"bands":[[0,5],..],"axes":{"ax":{"rms":[..],"peaks":[[Гц,амплитуда],..]},..}}
+/// @return длина JSON, 0 - окно еще не посчитано
+size_t spectrum_format_json(spectrum_analyzer *s, char *buf, size_t len)
+{
+    size_t used;
+
+    pthread_mutex_lock(&s->lock);
+    const spectrum_result *r = &s->result;
+    if (!r->valid)
+    {
+        pthread_mutex_unlock(&s->lock);
+        return 0;
+    }
+    used = stats_append(buf, len, 0, "{\"seq\":%u,\"ts_us\":%llu,\"rate_hz\":%g,\"n\":%d,\"bands\":[",
+        r->seq, (unsigned long long)r->ts_us, r->rate_hz, SPECTRUM_N);
+    for (size_t b = 0; b < s->band_count; b++)
+        used = stats_append(buf, len, used, "%s[%g,%g]", b ? "," : "", s->bands[b].low_hz, s->bands[b].high_hz);
+    used = stats_append(buf, len, used, "],\"axes\":{");
+    for (size_t axis = 0; axis < SPECTRUM_AXES; axis++)
+    {
+        used = stats_append(buf, len, used, "%s\"%s\":{\"rms\":[", axis ? "," : "", axis_names[axis]);
+        for (size_t b = 0; b < s->band_count; b++)
+            used = stats_append(buf, len, used, "%s%.4g", b ? "," : "", r->rms[axis][b]);
+        used = stats_append(buf, len, used, "],\"peaks\":[");
+        for (size_t i = 0; i < SPECTRUM_PEAKS && r->peaks[axis][i].hz > 0; i++)
+            used = stats_append(buf, len, used, "%s[%.2f,%.4g]", i ? "," : "", r->peaks[axis][i].hz,
+                                r->peaks[axis][i].amplitude);
+        used = stats_append(buf, len, used, "]}");
+    }
+    used = stats_append(buf, len, used, "}}");
+    pthread_mutex_unlock(&s->lock);
+    return used;
+}
@@ -0,0 +1,99 @@
+#ifndef SPECTRUM_H
+#define SPECTRUM_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+#include "epoch.h"
+
+#define SPECTRUM_N 256                     // отсчетов в окне, степень двойки (1.28 с при 200 Гц)
+#define SPECTRUM_HALF (SPECTRUM_N / 2)     // длина комплексного БПФ
+#define SPECTRUM_BINS (SPECTRUM_HALF + 1)  // частоты 0..fs/2
+#define SPECTRUM_HOP (SPECTRUM_N / 2)      // перекрытие окон 50%
+#define SPECTRUM_AXES 6                    // ax ay az gx gy gz
+#define SPECTRUM_BANDS_MAX 6
+#define SPECTRUM_PEAKS 3
+#define SPECTRUM_DEFAULT_BANDS "0-5,5-10,10-20,20-50,50-100"
+#define SPECTRUM_JSON_MAX 1536
+#define SPECTRUM_TEXT_MAX 1536
+
+typedef struct
+{
+    float re;
+    float im;
+} spectrum_complex;
+
+typedef struct
+{
+    float low_hz;
+    float high_hz;
+} spectrum_band;
+
+/// @brief пик спектра: частота и амплитуда синусоиды, уточненные параболой по трем бинам
+typedef struct
+{
+    float hz;
+    float amplitude;
+} spectrum_peak;
+
+/// @brief результат последнего окна. rms - СКЗ сигнала в полосе (м/с^2 или град/с)
+typedef struct
+{
+    bool valid;
+    uint32_t seq;          // номер последнего цикла в окне
+    uint64_t ts_us;
+    uint64_t windows;
+    float rate_hz;
+    float rms[SPECTRUM_AXES][SPECTRUM_BANDS_MAX];
+    spectrum_peak peaks[SPECTRUM_AXES][SPECTRUM_PEAKS];
+} spectrum_result;
+
+/// @brief таблицы БПФ и рабочие буферы анализатора, выделяются при запуске (spectrum_start)
+typedef struct
+{
+    float window[SPECTRUM_N];
+    spectrum_complex twiddle[SPECTRUM_HALF];   // этапы radix-4 подряд: для каждого k множители W^k, W^2k, W^3k
+    spectrum_complex split[SPECTRUM_BINS];     // exp(-2 pi i k / N) для разделения спектра
+    uint16_t bitrev[SPECTRUM_HALF];
+
+    float history[SPECTRUM_AXES][SPECTRUM_N];  // кольцо последних отсчетов по осям
+
+    spectrum_complex work[SPECTRUM_HALF];
+    float power[SPECTRUM_BINS];
+} spectrum_buffers;
+
+/// @brief спектральный анализ ускорения и угловой скорости по осям: окно Ханна на SPECTRUM_N отсчетов
+/// с перекрытием 50%, БПФ действительного сигнала через комплексное БПФ половинной длины (radix-4,
+/// при нечетном log2 длины первый этап radix-2).
+/// spectrum_init задает полосы по умолчанию (полосы можно менять до запуска), окно, поворачивающие
+/// множители по этапам и таблица перестановки считаются один раз в spectrum_start.
+/// Поток чтения вызывает spectrum_push на каждый цикл, результат читается под lock по запросу клиента.
+/// Окно набирается только из циклов с кадрами ускорения и угловой скорости, цикл без них начинает окно заново
+typedef struct
+{
+    spectrum_band bands[SPECTRUM_BANDS_MAX];
+    size_t band_count;
+    float rate_hz;
+
+    spectrum_buffers *buffers;
+    float window_sum;                          // сумма окна, для амплитуды пиков
+    float window_power;                        // сумма квадратов окна, для СКЗ полос
+    size_t head;
+    size_t filled;
+    size_t since_window;
+
+    pthread_mutex_t lock;
+    spectrum_result result;
+} spectrum_analyzer;
+
+void spectrum_init(spectrum_analyzer *s);
+bool spectrum_start(spectrum_analyzer *s, spectrum_buffers *buffers);
+bool spectrum_parse_bands(spectrum_analyzer *s, const char *spec);
+void spectrum_set_rate(spectrum_analyzer *s, double rate_hz);
+bool spectrum_push(spectrum_analyzer *s, const hwt905_epoch *epoch, uint64_t ts_us);
+size_t spectrum_format_text(spectrum_analyzer *s, char *buf, size_t len);
+size_t spectrum_format_json(spectrum_analyzer *s, char *buf, size_t len);
+
+#endif // SPECTRUM_H
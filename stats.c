@@ -0,0 +1,70 @@
+#include "stats.h"
+
+#include <stdio.h>
+#include <stdarg.h>
+
+#include "frame.h"
+
+/// @brief дописать строку в отчет
+/// @param buf буфер отчета
+/// @param len размер буфера
+/// @param used уже записано
+/// @return новая длина отчета (не больше len - 1)
+size_t stats_append(char *buf, size_t len, size_t used, const char *format, ...)
+{
+    va_list args;
+
+    if (used + 1 >= len)
+        return used;
+    va_start(args, format);
+    int n = vsnprintf(buf + used, len - used, format, args);
+    va_end(args);
+    if (n < 0)
+        return used;
+    return used + (size_t)n < len ? used + (size_t)n : len - 1;
+}
+
+/// @brief отчет по этапам от порта до сборки циклов со сверкой: каждый байт и каждый кадр
+/// либо дошел до следующего этапа, либо учтен как потерянный, либо еще в обработке.
+/// При вызове из другого потока значения снимаются на ходу, сверка может расходиться на один кадр
+/// @param stats счетчики и снимок ring_bytes, assembler_frames
+/// @param buf буфер отчета
+/// @param len размер буфера
+/// @return длина отчета
+size_t stats_format(const pipeline_stats *stats, char *buf, size_t len)
+{
+    uint64_t ring_bytes = stats_get(&stats->ring_bytes);
+    uint64_t assembler_frames = stats_get(&stats->assembler_frames);
+    uint64_t bytes_read = stats_get(&stats->bytes_read);
+    uint64_t overflow = stats_get(&stats->bytes_overflow);
+    uint64_t resync = stats_get(&stats->bytes_resync);
+    uint64_t frames = stats_get(&stats->frames);
+    uint64_t crc = stats_get(&stats->frames_crc);
+    uint64_t unknown = stats_get(&stats->frames_unknown);
+    uint64_t readback = stats_get(&stats->frames_readback);
+    uint64_t data = stats_get(&stats->frames_data);
+    uint64_t epoch_frames = stats_get(&stats->epoch_frames);
+    size_t used = 0;
+
+    int64_t byte_balance = (int64_t)(bytes_read - overflow - resync - frames * HWT905_FRAME_LEN - ring_bytes);
+    int64_t frame_balance = (int64_t)(frames - crc - unknown - readback - data);
+    int64_t epoch_balance = (int64_t)(data - epoch_frames - assembler_frames);
+
+    used = stats_append(buf, len, used, "порт: порций %llu, байт %llu, ошибок чтения %llu\n",
+        (unsigned long long)stats_get(&stats->chunks), (unsigned long long)bytes_read,
+        (unsigned long long)stats_get(&stats->read_errors));
+    used = stats_append(buf, len, used, "кольцевой буфер: потеряно при переполнении %llu байт, в буфере %llu\n",
+        (unsigned long long)overflow, (unsigned long long)ring_bytes);
+    used = stats_append(buf, len, used, "поиск заголовка: пропущено %llu байт\n", (unsigned long long)resync);
+    used = stats_append(buf, len, used, "кадры: извлечено %llu = данные %llu + чтение регистра %llu + "
+        "ошибка CRC %llu + неизвестный тип %llu\n", (unsigned long long)frames, (unsigned long long)data,
+        (unsigned long long)readback, (unsigned long long)crc, (unsigned long long)unknown);
+    used = stats_append(buf, len, used, "циклы: выдано %llu, кадров в циклах %llu, в сборке %llu\n",
+        (unsigned long long)stats_get(&stats->epochs), (unsigned long long)epoch_frames,
+        (unsigned long long)assembler_frames);
+    used = stats_append(buf, len, used, "сверка: байты %lld, кадры %lld, циклы %lld (0 - без расхождений)\n",
+        (long long)byte_balance, (long long)frame_balance, (long long)epoch_balance);
+    used = stats_append(buf, len, used, "потери до потребителей: %llu байт, %llu кадров\n",
+        (unsigned long long)(overflow + resync), (unsigned long long)(crc + unknown));
+    return used;
+}
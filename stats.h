@@ -0,0 +1,68 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+
+/// @brief счетчики этапов конвейера: порция read() -> кольцевой буфер -> кадр -> цикл -> потребители.
+/// Номер порции и номер кадра - текущие значения chunks и frames, номер цикла - hwt905_epoch.seq.
+/// Пишет только поток чтения (stats_add, без блокирующих инструкций), канал управления читает для STATS
+typedef struct
+{
+    _Atomic uint64_t chunks;            // порции read() с данными
+    _Atomic uint64_t bytes_read;
+    _Atomic uint64_t read_errors;       // read() вернул -1 не из-за отсутствия данных
+    _Atomic uint64_t bytes_overflow;    // порции, не поместившиеся в кольцевой буфер
+    _Atomic uint64_t bytes_resync;      // байты, пропущенные при поиске заголовка 0x55
+    _Atomic uint64_t frames;            // кадры по 11 байт, извлеченные из кольцевого буфера
+    _Atomic uint64_t frames_crc;        // неверная контрольная сумма
+    _Atomic uint64_t frames_unknown;    // неизвестный тип кадра
+    _Atomic uint64_t frames_readback;   // ответы чтения регистра 0x5F
+    _Atomic uint64_t frames_data;       // кадры 0x50..0x59, переданные сборщику циклов
+    _Atomic uint64_t epochs;            // выданные циклы
+    _Atomic uint64_t epoch_frames;      // кадры в выданных циклах
+    _Atomic uint64_t tcp_sent;          // номер сообщения TCP клиента
+    _Atomic uint64_t tcp_failed;
+    _Atomic uint64_t archive_failed;
+
+    // снимок состояния, которое меняет только поток чтения; обновляется раз за проход цикла чтения
+    // (stats_set), чтобы канал управления не читал поля кольцевого буфера, сборщика и потребителей на ходу
+    _Atomic uint64_t ring_bytes;        // байт в кольцевом буфере
+    _Atomic uint64_t assembler_frames;  // кадров в собираемом цикле
+    _Atomic uint64_t archive_written;
+    _Atomic uint64_t archive_pending;   // отсчетов в незаписанном блоке архива
+    _Atomic uint64_t mcast_sent;
+    _Atomic uint64_t mcast_failed;
+    _Atomic uint64_t mcast_pending;     // отсчетов в неотправленной датаграмме
+    _Atomic uint64_t mcast_datagrams;
+    _Atomic uint64_t mcast_errors;
+    _Atomic uint64_t trigger_fired;
+    _Atomic uint64_t trigger_dropped;
+} pipeline_stats;
+
+/// @brief увеличить счетчик. Писатель один, поэтому атомарное сложение не нужно:
+/// достаточно, чтобы читатель не увидел разорванное значение
+static inline void stats_add(_Atomic uint64_t *counter, uint64_t value)
+{
+    atomic_store_explicit(counter, atomic_load_explicit(counter, memory_order_relaxed) + value,
+                          memory_order_relaxed);
+}
+
+/// @brief записать значение снимка, писатель тот же один поток
+static inline void stats_set(_Atomic uint64_t *counter, uint64_t value)
+{
+    atomic_store_explicit(counter, value, memory_order_relaxed);
+}
+
+static inline uint64_t stats_get(const _Atomic uint64_t *counter)
+{
+    return atomic_load_explicit((_Atomic uint64_t*)counter, memory_order_relaxed);
+}
+
+size_t stats_append(char *buf, size_t len, size_t used, const char *format, ...)
+    __attribute__((format(printf, 4, 5)));
+size_t stats_format(const pipeline_stats *stats, char *buf, size_t len);
+
+#endif // STATS_H
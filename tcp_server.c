@@ -37,29 +37,39 @@ bool start_TCP_server(int *server_fd, struct sockaddr_in *address, int *opt, int
 }
 
 
-void form_answer_buffer(char* buffer, size_t size, hwt905_values *data, int count)
+/// @brief отправка записи цикла клиенту в текстовом формате
+/// @param epoch запись цикла
+/// @param ts_us время отсчета, микросекунды UTC
+/// @param encoder текстовый кодировщик (human, csv, json)
+/// @param client_socket сокет клиента
+bool send_data(const hwt905_epoch *epoch, uint64_t ts_us, const text_encoder *encoder, int client_socket)
 {
-    snprintf(buffer, size,
-        "%d: Данные HWT905 | message number = %i | acceleration (%lf; %lf; %lf), "
-        "MF (%i; %i; %i), Angular velocity (%lf; %lf; %lf), Temp = %lf\n",
-        getpid(), count,
-        data->acceleration[0], data->acceleration[1], data->acceleration[2],
-        data->magneta[0], data->magneta[1], data->magneta[2],
-        data->angularVelocity[0], data->angularVelocity[1], data->angularVelocity[2],
-        data->temperature);
-}
-
-
-bool send_data( hwt905_values *data, int client_socket)
-{
-    char response[1024];
-    form_answer_buffer(response, sizeof(response), data, 1);
-    if (send(client_socket, response, strlen(response), 0) != strlen(response))
+    char response[TEXT_ENCODER_MAX];
+    size_t len = encoder->encode(response, epoch, ts_us);
+    if (send(client_socket, response, len, MSG_NOSIGNAL) != (ssize_t)len)
     {
         printf("Ошика при отправке\n");
         return false;
     }
-    printf("Сообщение успешно отправлено");
     return true;
 }
 
+
+
+/// @brief уведомление клиента о новой частоте вывода устройства, строка "RATE <Гц>"
+bool send_rate(double rate_hz, int client_socket)
+{
+    char message[32];
+    int len = snprintf(message, sizeof(message), "RATE %g\n", rate_hz);
+    return send(client_socket, message, len, MSG_NOSIGNAL) == len;
+}
+
+/// @brief уведомление клиента о закрытом окне события, строка "TRIGGER <номер> <условие> <цикл> <отсчетов>"
+bool send_trigger(uint32_t number, const char *condition, uint32_t trigger_seq, size_t samples, int client_socket)
+{
+    char message[128];
+    int len = snprintf(message, sizeof(message), "TRIGGER %u %s %u %zu\n", number, condition, trigger_seq, samples);
+    if (len >= (int)sizeof(message))
+        len = sizeof(message) - 1;
+    return send(client_socket, message, len, MSG_NOSIGNAL) == len;
+}
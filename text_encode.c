@@ -0,0 +1,359 @@
+#include "text_encode.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <math.h>
+#include <unistd.h>
+
+// Быстрое текстовое кодирование отсчетов. Числа форматируются вручную в фиксированную точку:
+// x * 10^precision округляется до целого, целая и дробная части выводятся по две цифры за шаг.
+// Результат совпадает с printf("%.*f"): там, где округление произведения могло бы дать
+// другой результат (значение у границы половины младшего разряда, очень большие числа, nan, inf),
+// используется snprintf
+
+static const char digit_pairs[] =
+    "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+    "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+
+static const double pow10_table[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9};
+
+#define ARRAY_LEN(array) (sizeof(array) / sizeof((array)[0]))
+
+/// @brief запись десятичных цифр числа в конец буфера tmp
+/// @return указатель на первую цифру
+static char* write_digits(char *end, unsigned long long x)
+{
+    while (x >= 100)
+    {
+        unsigned i = (unsigned)(x % 100) * 2;
+        x /= 100;
+        *--end = digit_pairs[i + 1];
+        *--end = digit_pairs[i];
+    }
+    if (x >= 10)
+    {
+        *--end = digit_pairs[x * 2 + 1];
+        *--end = digit_pairs[x * 2];
+    }
+    else
+    {
+        *--end = (char)('0' + x);
+    }
+    return end;
+}
+
+size_t fmt_uint(char *out, unsigned long long x)
+{
+    char tmp[FMT_INT_MAX];
+    char *begin = write_digits(tmp + sizeof(tmp), x);
+    size_t len = (size_t)(tmp + sizeof(tmp) - begin);
+    memcpy(out, begin, len);
+    return len;
+}
+
+size_t fmt_int(char *out, long long x)
+{
+    if (x < 0)
+    {
+        *out = '-';
+        return 1 + fmt_uint(out + 1, 0ULL - (unsigned long long)x);
+    }
+    return fmt_uint(out, (unsigned long long)x);
+}
+
+static size_t fmt_fixed_slow(char *out, double x, int precision)
+{
+    char tmp[FMT_FIXED_MAX + 1];
+    int len = snprintf(tmp, sizeof(tmp), "%.*f", precision, x);
+    if (len < 0)
+        return 0;
+    if (len > FMT_FIXED_MAX)
+        len = FMT_FIXED_MAX;  // |x| > 1e15, для данных датчика недостижимо
+    memcpy(out, tmp, (size_t)len);
+    return (size_t)len;
+}
+
+/// @brief число в фиксированной точке, побайтно как printf("%.*f", precision, x)
+/// @param out буфер не меньше FMT_FIXED_MAX байт, завершающий ноль не пишется
+/// @param x число
+/// @param precision знаков после точки, 0..9
+/// @return длина записанного текста
+size_t fmt_fixed(char *out, double x, int precision)
+{
+    if (precision < 0 || precision >= (int)ARRAY_LEN(pow10_table) || !isfinite(x))
+        return fmt_fixed_slow(out, x, precision);
+
+    double scale = pow10_table[precision];
+    double q = fabs(x) * scale;
+    if (q >= 0x1p52)
+        return fmt_fixed_slow(out, x, precision);
+
+    // q отличается от точного произведения не больше чем на половину ulp(q) <= q * 2^-53,
+    // поэтому округление однозначно, если дробная часть дальше от 0.5 чем ulp(q)
+    unsigned long long n = (unsigned long long)q;
+    double frac = q - (double)n;
+    if (fabs(frac - 0.5) <= q * 0x1p-52)
+        return fmt_fixed_slow(out, x, precision);
+    if (frac > 0.5)
+        n++;
+
+    unsigned long long unit = (unsigned long long)scale;
+    char tmp[FMT_FIXED_MAX];
+    char *end = tmp + sizeof(tmp);
+    char *p = end;
+
+    if (precision > 0)
+    {
+        char *frac_end = p;
+        p = write_digits(p, n % unit);
+        while (frac_end - p < precision)
+            *--p = '0';
+        *--p = '.';
+    }
+    p = write_digits(p, n / unit);
+    if (signbit(x))
+        *--p = '-';  // как у printf: -0.000000 для отрицательных значений, округленных до нуля
+
+    size_t len = (size_t)(end - p);
+    memcpy(out, p, len);
+    return len;
+}
+
+// Постоянные части строк копируются memcpy с длиной, известной при компиляции
+#define PUT_LITERAL(p, literal) (memcpy((p), (literal), sizeof(literal) - 1), (p) += sizeof(literal) - 1)
+#define LITERAL_LEN(literal) (sizeof(literal) - 1)
+
+static char* put_fixed(char *p, double x)
+{
+    return p + fmt_fixed(p, x, TEXT_PRECISION);
+}
+
+static char* put_int(char *p, long long x)
+{
+    return p + fmt_int(p, x);
+}
+
+// Прежняя строка TCP клиента, формировалась через snprintf:
+// "%d: Данные HWT905 | message number = %i | acceleration (%lf; %lf; %lf), "
+// "MF (%i; %i; %i), Angular velocity (%lf; %lf; %lf), Temp = %lf\n"
+#define HUMAN_NUMBER ": Данные HWT905 | message number = "
+#define HUMAN_ACC " | acceleration ("
+#define HUMAN_SEP "; "
+#define HUMAN_MF "), MF ("
+#define HUMAN_GYRO "), Angular velocity ("
+#define HUMAN_TEMP "), Temp = "
+
+#define HUMAN_MAX_LEN (2 * FMT_INT_MAX + 3 * FMT_INT_MAX + 7 * FMT_FIXED_MAX + LITERAL_LEN(HUMAN_NUMBER) + \
+    LITERAL_LEN(HUMAN_ACC) + 6 * LITERAL_LEN(HUMAN_SEP) + LITERAL_LEN(HUMAN_MF) + LITERAL_LEN(HUMAN_GYRO) + \
+    LITERAL_LEN(HUMAN_TEMP) + 1)
+
+static size_t encode_human(char *out, const hwt905_epoch *epoch, uint64_t ts_us)
+{
+    static int pid = 0;
+    const hwt905_values *v = &epoch->values;
+    char *p = out;
+    (void) ts_us;
+
+    if (pid == 0)
+        pid = getpid();
+
+    p = put_int(p, pid);
+    PUT_LITERAL(p, HUMAN_NUMBER);
+    p = put_int(p, (int)epoch->seq);
+    PUT_LITERAL(p, HUMAN_ACC);
+    p = put_fixed(p, v->acceleration[0]);
+    PUT_LITERAL(p, HUMAN_SEP);
+    p = put_fixed(p, v->acceleration[1]);
+    PUT_LITERAL(p, HUMAN_SEP);
+    p = put_fixed(p, v->acceleration[2]);
+    PUT_LITERAL(p, HUMAN_MF);
+    p = put_int(p, v->magneta[0]);
+    PUT_LITERAL(p, HUMAN_SEP);
+    p = put_int(p, v->magneta[1]);
+    PUT_LITERAL(p, HUMAN_SEP);
+    p = put_int(p, v->magneta[2]);
+    PUT_LITERAL(p, HUMAN_GYRO);
+    p = put_fixed(p, v->angularVelocity[0]);
+    PUT_LITERAL(p, HUMAN_SEP);
+    p = put_fixed(p, v->angularVelocity[1]);
+    PUT_LITERAL(p, HUMAN_SEP);
+    p = put_fixed(p, v->angularVelocity[2]);
+    PUT_LITERAL(p, HUMAN_TEMP);
+    p = put_fixed(p, v->temperature);
+    *p++ = '\n';
+    return (size_t)(p - out);
+}
+
+// CSV: одна строка на цикл, столбцы как в заголовке CSV_HEADER
+#define CSV_HEADER "seq,mask,ts_us,acc_x,acc_y,acc_z,gyro_x,gyro_y,gyro_z,angle_x,angle_y,angle_z," \
+    "mag_x,mag_y,mag_z,q0,q1,q2,q3,temp\n"
+#define CSV_MAX_LEN (3 * FMT_INT_MAX + 13 * FMT_FIXED_MAX + 3 * FMT_INT_MAX + 19 + 1)
+
+static size_t encode_csv(char *out, const hwt905_epoch *epoch, uint64_t ts_us)
+{
+    const hwt905_values *v = &epoch->values;
+    char *p = out;
+
+    p += fmt_uint(p, epoch->seq);
+    *p++ = ',';
+    p += fmt_uint(p, epoch->mask);
+    *p++ = ',';
+    p += fmt_uint(p, ts_us);
+    for (int i = 0; i < 3; i++)
+    {
+        *p++ = ',';
+        p = put_fixed(p, v->acceleration[i]);
+    }
+    for (int i = 0; i < 3; i++)
+    {
+        *p++ = ',';
+        p = put_fixed(p, v->angularVelocity[i]);
+    }
+    for (int i = 0; i < 3; i++)
+    {
+        *p++ = ',';
+        p = put_fixed(p, v->angle[i]);
+    }
+    for (int i = 0; i < 3; i++)
+    {
+        *p++ = ',';
+        p = put_int(p, v->magneta[i]);
+    }
+    for (int i = 0; i < 4; i++)
+    {
+        *p++ = ',';
+        p = put_fixed(p, v->quaterion[i]);
+    }
+    *p++ = ',';
+    p = put_fixed(p, v->temperature);
+    *p++ = '\n';
+    return (size_t)(p - out);
+}
+
+// JSON: тот же объект, который раньше собирался snprintf в http_stream.c
+#define JSON_SEQ "{\"seq\":"
+#define JSON_MASK ",\"mask\":"
+#define JSON_TS ",\"ts_us\":"
+#define JSON_ACC ",\"acc\":["
+#define JSON_GYRO "],\"gyro\":["
+#define JSON_ANGLE "],\"angle\":["
+#define JSON_MAG "],\"mag\":["
+#define JSON_QUAT "],\"quat\":["
+#define JSON_TEMP "],\"temp\":"
+
+#define JSON_MAX_LEN (3 * FMT_INT_MAX + 13 * FMT_FIXED_MAX + 3 * FMT_INT_MAX + LITERAL_LEN(JSON_SEQ) + \
+    LITERAL_LEN(JSON_MASK) + LITERAL_LEN(JSON_TS) + LITERAL_LEN(JSON_ACC) + LITERAL_LEN(JSON_GYRO) + \
+    LITERAL_LEN(JSON_ANGLE) + LITERAL_LEN(JSON_MAG) + LITERAL_LEN(JSON_QUAT) + LITERAL_LEN(JSON_TEMP) + 12 + 2)
+
+static char* put_fixed_list(char *p, const double *values, int count)
+{
+    for (int i = 0; i < count; i++)
+    {
+        if (i > 0)
+            *p++ = ',';
+        p = put_fixed(p, values[i]);
+    }
+    return p;
+}
+
+/// @brief JSON объект записи цикла без перевода строки (для HTTP)
+/// @param out буфер не меньше TEXT_JSON_MAX байт
+/// @return длина
+size_t text_encode_json(char *out, const hwt905_epoch *epoch, uint64_t ts_us)
+{
+    const hwt905_values *v = &epoch->values;
+    char *p = out;
+
+    PUT_LITERAL(p, JSON_SEQ);
+    p += fmt_uint(p, epoch->seq);
+    PUT_LITERAL(p, JSON_MASK);
+    p += fmt_uint(p, epoch->mask);
+    PUT_LITERAL(p, JSON_TS);
+    p += fmt_uint(p, ts_us);
+    PUT_LITERAL(p, JSON_ACC);
+    p = put_fixed_list(p, v->acceleration, 3);
+    PUT_LITERAL(p, JSON_GYRO);
+    p = put_fixed_list(p, v->angularVelocity, 3);
+    PUT_LITERAL(p, JSON_ANGLE);
+    for (int i = 0; i < 3; i++)
+    {
+        if (i > 0)
+            *p++ = ',';
+        p = put_fixed(p, v->angle[i]);
+    }
+    PUT_LITERAL(p, JSON_MAG);
+    for (int i = 0; i < 3; i++)
+    {
+        if (i > 0)
+            *p++ = ',';
+        p = put_int(p, v->magneta[i]);
+    }
+    PUT_LITERAL(p, JSON_QUAT);
+    p = put_fixed_list(p, v->quaterion, 4);
+    PUT_LITERAL(p, JSON_TEMP);
+    p = put_fixed(p, v->temperature);
+    *p++ = '}';
+    return (size_t)(p - out);
+}
+
+static size_t encode_json_line(char *out, const hwt905_epoch *epoch, uint64_t ts_us)
+{
+    size_t len = text_encode_json(out, epoch, ts_us);
+    out[len++] = '\n';
+    return len;
+}
+
+// Сырые кадры: seq,mask,ts_us, затем кадры цикла в hex по возрастанию типа
+#define RAW_MAX_LEN (3 * FMT_INT_MAX + 2 + FRAME_TYPES * (1 + 2 * HWT905_FRAME_LEN) + 1)
+
+static size_t encode_raw(char *out, const hwt905_epoch *epoch, uint64_t ts_us)
+{
+    static const char hex[] = "0123456789ABCDEF";
+    char *p = out;
+
+    p += fmt_uint(p, epoch->seq);
+    *p++ = ',';
+    p += fmt_uint(p, epoch->mask);
+    *p++ = ',';
+    p += fmt_uint(p, ts_us);
+    for (int type = 0; type < FRAME_TYPES; type++)
+    {
+        if (!(epoch->mask & (1u << type)))
+            continue;
+        *p++ = ',';
+        for (int i = 0; i < HWT905_FRAME_LEN; i++)
+        {
+            *p++ = hex[epoch->frames[type][i] >> 4];
+            *p++ = hex[epoch->frames[type][i] & 0x0F];
+        }
+    }
+    *p++ = '\n';
+    return (size_t)(p - out);
+}
+
+_Static_assert(HUMAN_MAX_LEN <= TEXT_ENCODER_MAX, "TEXT_ENCODER_MAX");
+_Static_assert(RAW_MAX_LEN <= TEXT_ENCODER_MAX, "TEXT_ENCODER_MAX");
+_Static_assert(CSV_MAX_LEN <= TEXT_ENCODER_MAX, "TEXT_ENCODER_MAX");
+_Static_assert(JSON_MAX_LEN <= TEXT_ENCODER_MAX, "TEXT_ENCODER_MAX");
+_Static_assert(JSON_MAX_LEN <= TEXT_JSON_MAX, "TEXT_JSON_MAX");
+
+const text_encoder text_encoder_human = {"human", NULL, EPOCH_HUMAN_FIELDS, HUMAN_MAX_LEN, encode_human};
+const text_encoder text_encoder_csv = {"csv", CSV_HEADER, EPOCH_DEFAULT_MASK, CSV_MAX_LEN, encode_csv};
+const text_encoder text_encoder_json = {"json", NULL, EPOCH_DEFAULT_MASK, JSON_MAX_LEN, encode_json_line};
+const text_encoder text_encoder_raw = {"raw", NULL, 0, RAW_MAX_LEN, encode_raw};
+
+/// @brief поиск кодировщика по имени: human, csv, json, raw
+/// @return кодировщик или NULL
+const text_encoder* text_encoder_find(const char *name)
+{
+    const text_encoder *encoders[] = {&text_encoder_human, &text_encoder_csv, &text_encoder_json, &text_encoder_raw};
+
+    for (size_t i = 0; i < ARRAY_LEN(encoders); i++)
+    {
+        if (strcasecmp(encoders[i]->name, name) == 0)
+            return encoders[i];
+    }
+    return NULL;
+}
@@ -0,0 +1,42 @@
+#ifndef TEXT_ENCODE_H
+#define TEXT_ENCODE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#include "epoch.h"
+
+#define TEXT_PRECISION 6       // знаков после точки, как у %lf
+#define FMT_FIXED_MAX 24       // максимальная длина числа от fmt_fixed
+#define FMT_INT_MAX 20         // максимальная длина целого от fmt_int/fmt_uint
+
+size_t fmt_fixed(char *out, double x, int precision);
+size_t fmt_int(char *out, long long x);
+size_t fmt_uint(char *out, unsigned long long x);
+
+/// @brief кодирование записи цикла в текст без выделения памяти и без snprintf.
+/// encode пишет не больше max_len байт (без завершающего нуля) и возвращает длину
+typedef size_t (*text_encode_fn)(char *out, const hwt905_epoch *epoch, uint64_t ts_us);
+
+typedef struct
+{
+    const char *name;
+    const char *header;  // строка, отправляемая клиенту при подключении, или NULL
+    uint16_t fields;     // кадры, которые нужно преобразовать перед кодированием (биты RSW)
+    size_t max_len;
+    text_encode_fn encode;
+} text_encoder;
+
+#define TEXT_ENCODER_MAX 640   // не меньше max_len любого кодировщика
+#define TEXT_JSON_MAX 560      // не меньше длины объекта text_encode_json
+
+extern const text_encoder text_encoder_human;  // прежняя строка TCP клиента (snprintf)
+extern const text_encoder text_encoder_csv;
+extern const text_encoder text_encoder_json;   // JSON Lines, тот же объект, что в HTTP
+extern const text_encoder text_encoder_raw;    // сырые кадры цикла в hex, без преобразования
+
+size_t text_encode_json(char *out, const hwt905_epoch *epoch, uint64_t ts_us);
+const text_encoder* text_encoder_find(const char *name);
+
+#endif // TEXT_ENCODE_H
@@ -0,0 +1,323 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <math.h>
+#include <limits.h>
+#include <float.h>
+#include <time.h>
+
+#include "text_encode.h"
+
+// Проверка текстовых кодировщиков по эталону printf.
+// text_encode_test [-n количество] - fmt_fixed сравнивается с printf("%.*f") на граничных и случайных числах,
+// fmt_int/fmt_uint - с %lld/%llu, кодировщики human, csv, json и raw - с той же строкой, собранной snprintf.
+// Код возврата 1 при расхождении, первые 10 расхождений выводятся (ожидаемая и полученная строка).
+// text_encode_test -b - скорость кодирования в сравнении с snprintf, нс на число и на запись
+
+static uint64_t rng_state = 0x9E3779B97F4A7C15ULL;
+
+static uint64_t rng_next(void)
+{
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return rng_state;
+}
+
+/// @brief случайное число в диапазоне [-range, range]
+static double rng_range(double range)
+{
+    return ((double)(rng_next() >> 11) * 0x1p-53 * 2. - 1.) * range;
+}
+
+/// @brief произвольное конечное число: случайные биты мантиссы и порядок от 2^-40 до 2^60
+static double rng_double(void)
+{
+    double mantissa = 1. + (double)(rng_next() >> 12) * 0x1p-52;
+    int exponent = (int)(rng_next() % 101) - 40;
+    return ldexp(rng_next() & 1 ? -mantissa : mantissa, exponent);
+}
+
+static double now_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static unsigned long long failures = 0;
+
+static void compare(const char *what, const char *expected, size_t expected_len, const char *actual, size_t actual_len)
+{
+    if (expected_len == actual_len && memcmp(expected, actual, actual_len) == 0)
+        return;
+    if (failures++ < 10)
+        printf("%s: ожидалось \"%.*s\", получено \"%.*s\"\n", what, (int)expected_len, expected, (int)actual_len, actual);
+}
+
+static void check_fixed(double x, int precision)
+{
+    char expected[512], actual[FMT_FIXED_MAX];
+    int len = snprintf(expected, sizeof(expected), "%.*f", precision, x);
+    if (len > FMT_FIXED_MAX)
+        len = FMT_FIXED_MAX;  // fmt_fixed обрезает числа длиннее FMT_FIXED_MAX
+    compare("fmt_fixed", expected, (size_t)len, actual, fmt_fixed(actual, x, precision));
+}
+
+static void check_int(long long x)
+{
+    char expected[32], actual[FMT_INT_MAX + 1];
+    int len = snprintf(expected, sizeof(expected), "%lld", x);
+    compare("fmt_int", expected, (size_t)len, actual, fmt_int(actual, x));
+    if (x >= 0)
+    {
+        len = snprintf(expected, sizeof(expected), "%llu", (unsigned long long)x);
+        compare("fmt_uint", expected, (size_t)len, actual, fmt_uint(actual, (unsigned long long)x));
+    }
+}
+
+static void test_numbers(unsigned long long count)
+{
+    static const double special[] = {
+        0., -0., 0.5, -0.5, 1.5, 2.5, 0.125, 0.375, 1e-7, -1e-7, 5e-7, -5e-7, 4.9999995e-7, 0.0000005,
+        1.0000005, 2.0000005, 0.1, 0.7, 1e15, -1e15, 1e16, 4503599627370495.5, 0x1p52, 0x1p53,
+        1e300, -1e300, 5e-324, DBL_MAX, NAN, -NAN, INFINITY, -INFINITY, 9.8, 156.8, 2000., -2000.
+    };
+
+    for (size_t i = 0; i < sizeof(special) / sizeof(special[0]); i++)
+    {
+        for (int precision = 0; precision <= 12; precision++)
+            check_fixed(special[i], precision);
+    }
+
+    for (unsigned long long i = 0; i < count; i++)
+    {
+        int precision = (int)(rng_next() % 10);
+        check_fixed(rng_double(), precision);
+        check_fixed(rng_range(16 * 9.8), TEXT_PRECISION);  // ускорение
+        check_fixed(rng_range(2000), TEXT_PRECISION);      // угловая скорость
+
+        // ровно половина младшего разряда в десятичной записи: k.ddd5 при precision знаках
+        double half = (double)(long long)(rng_next() % 100000000) + 0.5;
+        check_fixed(half / pow(10, precision), precision);
+        check_fixed(-half / pow(10, precision), precision);
+    }
+
+    static const long long special_int[] = {0, 1, 9, 10, 99, 100, 101, -1, -10, INT16_MIN, INT16_MAX,
+                                            INT_MIN, INT_MAX, LLONG_MIN, LLONG_MAX};
+    for (size_t i = 0; i < sizeof(special_int) / sizeof(special_int[0]); i++)
+        check_int(special_int[i]);
+    for (unsigned long long i = 0; i < count; i++)
+        check_int((long long)rng_next() >> (rng_next() % 64));
+
+    char expected[32], actual[FMT_INT_MAX];
+    int len = snprintf(expected, sizeof(expected), "%llu", ULLONG_MAX);
+    compare("fmt_uint", expected, (size_t)len, actual, fmt_uint(actual, ULLONG_MAX));
+}
+
+static void random_epoch(hwt905_epoch *epoch, uint32_t seq)
+{
+    hwt905_values *v = &epoch->values;
+
+    memset(epoch, 0, sizeof(*epoch));
+    epoch->seq = seq;
+    epoch->mask = (uint16_t)(rng_next() & ((1u << FRAME_TYPES) - 1));
+    for (int type = 0; type < FRAME_TYPES; type++)
+    {
+        for (int i = 0; i < HWT905_FRAME_LEN; i++)
+            epoch->frames[type][i] = (uint8_t)rng_next();
+    }
+    for (int i = 0; i < 3; i++)
+    {
+        // значения как после перевода из int16: слово * шкала / 32768
+        v->acceleration[i] = (int16_t)rng_next() / 32768. * 16 * HWT905_G;
+        v->angularVelocity[i] = (int16_t)rng_next() / 32768. * 2000;
+        v->angle[i] = (float)((int16_t)rng_next() / 32768. * 180);
+        v->magneta[i] = (int16_t)rng_next();
+    }
+    for (int i = 0; i < 4; i++)
+        v->quaterion[i] = (int16_t)rng_next() / 32768.;
+    v->temperature = (int16_t)rng_next() / 100.;
+}
+
+// эталонные строки кодировщиков, собранные snprintf
+
+static size_t reference_human(char *out, size_t size, const hwt905_epoch *epoch)
+{
+    const hwt905_values *v = &epoch->values;
+    return (size_t)snprintf(out, size,
+        "%d: Данные HWT905 | message number = %i | acceleration (%lf; %lf; %lf), "
+        "MF (%i; %i; %i), Angular velocity (%lf; %lf; %lf), Temp = %lf\n",
+        getpid(), (int)epoch->seq,
+        v->acceleration[0], v->acceleration[1], v->acceleration[2],
+        v->magneta[0], v->magneta[1], v->magneta[2],
+        v->angularVelocity[0], v->angularVelocity[1], v->angularVelocity[2],
+        v->temperature);
+}
+
+static size_t reference_csv(char *out, size_t size, const hwt905_epoch *epoch, uint64_t ts_us)
+{
+    const hwt905_values *v = &epoch->values;
+    return (size_t)snprintf(out, size,
+        "%u,%u,%llu,%lf,%lf,%lf,%lf,%lf,%lf,%lf,%lf,%lf,%d,%d,%d,%lf,%lf,%lf,%lf,%lf\n",
+        epoch->seq, epoch->mask, (unsigned long long)ts_us,
+        v->acceleration[0], v->acceleration[1], v->acceleration[2],
+        v->angularVelocity[0], v->angularVelocity[1], v->angularVelocity[2],
+        v->angle[0], v->angle[1], v->angle[2],
+        v->magneta[0], v->magneta[1], v->magneta[2],
+        v->quaterion[0], v->quaterion[1], v->quaterion[2], v->quaterion[3],
+        v->temperature);
+}
+
+static size_t reference_json(char *out, size_t size, const hwt905_epoch *epoch, uint64_t ts_us)
+{
+    const hwt905_values *v = &epoch->values;
+    return (size_t)snprintf(out, size,
+        "{\"seq\":%u,\"mask\":%u,\"ts_us\":%llu,\"acc\":[%lf,%lf,%lf],\"gyro\":[%lf,%lf,%lf],"
+        "\"angle\":[%lf,%lf,%lf],\"mag\":[%d,%d,%d],\"quat\":[%lf,%lf,%lf,%lf],\"temp\":%lf}\n",
+        epoch->seq, epoch->mask, (unsigned long long)ts_us,
+        v->acceleration[0], v->acceleration[1], v->acceleration[2],
+        v->angularVelocity[0], v->angularVelocity[1], v->angularVelocity[2],
+        v->angle[0], v->angle[1], v->angle[2],
+        v->magneta[0], v->magneta[1], v->magneta[2],
+        v->quaterion[0], v->quaterion[1], v->quaterion[2], v->quaterion[3],
+        v->temperature);
+}
+
+static size_t reference_raw(char *out, size_t size, const hwt905_epoch *epoch, uint64_t ts_us)
+{
+    size_t len = (size_t)snprintf(out, size, "%u,%u,%llu", epoch->seq, epoch->mask, (unsigned long long)ts_us);
+    for (int type = 0; type < FRAME_TYPES; type++)
+    {
+        if (!(epoch->mask & (1u << type)))
+            continue;
+        len += (size_t)snprintf(out + len, size - len, ",");
+        for (int i = 0; i < HWT905_FRAME_LEN; i++)
+            len += (size_t)snprintf(out + len, size - len, "%02X", epoch->frames[type][i]);
+    }
+    len += (size_t)snprintf(out + len, size - len, "\n");
+    return len;
+}
+
+static size_t reference_encode(const text_encoder *encoder, char *out, size_t size, const hwt905_epoch *epoch,
+                               uint64_t ts_us)
+{
+    if (encoder == &text_encoder_human)
+        return reference_human(out, size, epoch);
+    if (encoder == &text_encoder_csv)
+        return reference_csv(out, size, epoch, ts_us);
+    if (encoder == &text_encoder_json)
+        return reference_json(out, size, epoch, ts_us);
+    return reference_raw(out, size, epoch, ts_us);
+}
+
+static const text_encoder *const encoders[] = {
+    &text_encoder_human, &text_encoder_csv, &text_encoder_json, &text_encoder_raw
+};
+
+#define ENCODER_COUNT (sizeof(encoders) / sizeof(encoders[0]))
+
+static void test_encoders(unsigned long long count)
+{
+    hwt905_epoch epoch;
+    char expected[2048], actual[TEXT_ENCODER_MAX];
+
+    for (unsigned long long i = 0; i < count; i++)
+    {
+        random_epoch(&epoch, (uint32_t)rng_next());
+        uint64_t ts_us = rng_next() >> 12;
+        for (size_t e = 0; e < ENCODER_COUNT; e++)
+        {
+            size_t expected_len = reference_encode(encoders[e], expected, sizeof(expected), &epoch, ts_us);
+            size_t actual_len = encoders[e]->encode(actual, &epoch, ts_us);
+            if (actual_len > encoders[e]->max_len && failures++ < 10)
+                printf("%s: длина %zu больше max_len %zu\n", encoders[e]->name, actual_len, encoders[e]->max_len);
+            compare(encoders[e]->name, expected, expected_len, actual, actual_len);
+        }
+    }
+}
+
+#define BENCH_EPOCHS 1024
+
+/// @brief скорость кодирования: одни и те же записи кодируются многократно, результат суммируется,
+/// чтобы компилятор не выбросил вызовы
+static void benchmark(unsigned long long count)
+{
+    static hwt905_epoch epochs[BENCH_EPOCHS];
+    static double numbers[BENCH_EPOCHS];
+    char out[2048];
+    size_t total = 0;
+
+    for (size_t i = 0; i < BENCH_EPOCHS; i++)
+    {
+        random_epoch(&epochs[i], (uint32_t)i);
+        numbers[i] = epochs[i].values.acceleration[i % 3];
+    }
+
+    double start = now_seconds();
+    for (unsigned long long i = 0; i < count; i++)
+        total += fmt_fixed(out, numbers[i % BENCH_EPOCHS], TEXT_PRECISION);
+    double fast = now_seconds() - start;
+    start = now_seconds();
+    for (unsigned long long i = 0; i < count; i++)
+        total += (size_t)snprintf(out, sizeof(out), "%.*f", TEXT_PRECISION, numbers[i % BENCH_EPOCHS]);
+    double slow = now_seconds() - start;
+    printf("%-8s %8.1f нс/число, snprintf %8.1f нс/число, ускорение %.1f\n", "fixed",
+           fast * 1e9 / count, slow * 1e9 / count, slow / fast);
+
+    unsigned long long records = count / 16 + 1;
+    for (size_t e = 0; e < ENCODER_COUNT; e++)
+    {
+        start = now_seconds();
+        for (unsigned long long i = 0; i < records; i++)
+            total += encoders[e]->encode(out, &epochs[i % BENCH_EPOCHS], i);
+        fast = now_seconds() - start;
+        start = now_seconds();
+        for (unsigned long long i = 0; i < records; i++)
+            total += reference_encode(encoders[e], out, sizeof(out), &epochs[i % BENCH_EPOCHS], i);
+        slow = now_seconds() - start;
+        printf("%-8s %8.1f нс/запись, snprintf %8.1f нс/запись, ускорение %.1f\n", encoders[e]->name,
+               fast * 1e9 / records, slow * 1e9 / records, slow / fast);
+    }
+    printf("(контрольная сумма длин %zu)\n", total);
+}
+
+int main(int argc, char *argv[])
+{
+    unsigned long long count = 1000000;
+    bool bench = false;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "n:b")) != -1)
+    {
+        switch (opt)
+        {
+        case 'n':
+            count = strtoull(optarg, NULL, 0);
+            break;
+        case 'b':
+            bench = true;
+            break;
+        default:
+            printf("Использование: %s [-n количество] [-b]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    if (bench)
+    {
+        benchmark(count * 10);
+        return 0;
+    }
+
+    test_numbers(count);
+    test_encoders(count / 10);
+    if (failures != 0)
+    {
+        printf("Расхождений с printf: %llu\n", failures);
+        return 1;
+    }
+    printf("Совпадает с printf: %llu чисел, %llu записей\n", count, count / 10);
+    return 0;
+}
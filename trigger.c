@@ -0,0 +1,583 @@
+#include "trigger.h"
+#include "text_encode.h"
+#include "rt.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+#include <errno.h>
+#include <math.h>
+
+#define HISTORY_MASK (TRIGGER_HISTORY_SLOTS - 1)
+// окно закрывается досрочно, если занимает больше 3/4 истории: поток записи должен успеть его скопировать
+#define WINDOW_MAX_SAMPLES (TRIGGER_HISTORY_SLOTS * 3 / 4)
+
+_Static_assert((TRIGGER_HISTORY_SLOTS & HISTORY_MASK) == 0, "TRIGGER_HISTORY_SLOTS");
+
+enum TRIGGER_OP
+{
+    OP_CONST, OP_VAR, OP_NEG, OP_ABS,
+    OP_ADD, OP_SUB, OP_MUL, OP_DIV,
+    OP_LT, OP_GT, OP_LE, OP_GE,
+    OP_AND, OP_OR,
+    OP_LPAREN  // только в стеке операторов при компиляции
+};
+
+enum TRIGGER_VAR
+{
+    VAR_AX, VAR_AY, VAR_AZ, VAR_GX, VAR_GY, VAR_GZ,
+    VAR_ROLL, VAR_PITCH, VAR_YAW, VAR_MX, VAR_MY, VAR_MZ,
+    VAR_TEMP, VAR_ACC2, VAR_GYRO2
+};
+
+static const char *const var_names[] = {
+    "ax", "ay", "az", "gx", "gy", "gz", "roll", "pitch", "yaw", "mx", "my", "mz", "temp", "acc2", "gyro2"
+};
+
+#define ARRAY_LEN(array) (sizeof(array) / sizeof((array)[0]))
+
+static int precedence(uint8_t op)
+{
+    switch (op)
+    {
+    case OP_OR: return 1;
+    case OP_AND: return 2;
+    case OP_LT: case OP_GT: case OP_LE: case OP_GE: return 3;
+    case OP_ADD: case OP_SUB: return 4;
+    case OP_MUL: case OP_DIV: return 5;
+    case OP_NEG: case OP_ABS: return 6;
+    default: return 0;
+    }
+}
+
+static bool is_unary(uint8_t op)
+{
+    return op == OP_NEG || op == OP_ABS;
+}
+
+/// @brief добавить инструкцию в программу с проверкой длины и глубины стека
+static bool emit(trigger_condition *c, uint8_t op, uint8_t var, double value, int *depth)
+{
+    if (c->length == TRIGGER_PROGRAM_MAX)
+        return false;
+
+    if (op == OP_CONST || op == OP_VAR)
+        (*depth)++;
+    else if (!is_unary(op))
+        (*depth)--;
+    if (*depth < 1 || *depth > TRIGGER_STACK_MAX)
+        return false;
+
+    c->program[c->length].op = op;
+    c->program[c->length].var = var;
+    c->program[c->length].value = value;
+    c->length++;
+    return true;
+}
+
+/// @brief компиляция инфиксного выражения в обратную польскую запись (сортировочная станция)
+static bool compile_expression(trigger_condition *c, const char *text)
+{
+    uint8_t ops[TRIGGER_PROGRAM_MAX];
+    size_t ops_count = 0;
+    int depth = 0;
+    bool expect_operand = true;
+    const char *p = text;
+
+    c->length = 0;
+    while (*p != '\0')
+    {
+        if (isspace((unsigned char)*p))
+        {
+            p++;
+            continue;
+        }
+
+        if (expect_operand)
+        {
+            if (isdigit((unsigned char)*p) || *p == '.')
+            {
+                char *end;
+                double value = strtod(p, &end);
+                if (!emit(c, OP_CONST, 0, value, &depth))
+                    return false;
+                p = end;
+                expect_operand = false;
+            }
+            else if (isalpha((unsigned char)*p))
+            {
+                const char *begin = p;
+                while (isalnum((unsigned char)*p))
+                    p++;
+                size_t len = (size_t)(p - begin);
+
+                if (len == 3 && strncmp(begin, "abs", 3) == 0)
+                {
+                    if (ops_count + 1 >= ARRAY_LEN(ops))
+                        return false;
+                    ops[ops_count++] = OP_ABS;
+                    continue;  // дальше ожидается '('
+                }
+
+                size_t i;
+                for (i = 0; i < ARRAY_LEN(var_names); i++)
+                {
+                    if (strlen(var_names[i]) == len && strncmp(var_names[i], begin, len) == 0)
+                        break;
+                }
+                if (i == ARRAY_LEN(var_names) || !emit(c, OP_VAR, (uint8_t)i, 0, &depth))
+                {
+                    printf("Неизвестная переменная в условии: %.*s\n", (int)len, begin);
+                    return false;
+                }
+                expect_operand = false;
+            }
+            else if (*p == '(')
+            {
+                if (ops_count == ARRAY_LEN(ops))
+                    return false;
+                ops[ops_count++] = OP_LPAREN;
+                p++;
+            }
+            else if (*p == '-')
+            {
+                if (ops_count == ARRAY_LEN(ops))
+                    return false;
+                ops[ops_count++] = OP_NEG;
+                p++;
+            }
+            else
+            {
+                return false;
+            }
+            continue;
+        }
+
+        if (*p == ')')
+        {
+            while (ops_count > 0 && ops[ops_count - 1] != OP_LPAREN)
+            {
+                if (!emit(c, ops[--ops_count], 0, 0, &depth))
+                    return false;
+            }
+            if (ops_count == 0)
+                return false;
+            ops_count--;  // '('
+            if (ops_count > 0 && ops[ops_count - 1] == OP_ABS && !emit(c, ops[--ops_count], 0, 0, &depth))
+                return false;
+            p++;
+            continue;
+        }
+
+        uint8_t op;
+        if (strncmp(p, "&&", 2) == 0) { op = OP_AND; p += 2; }
+        else if (strncmp(p, "||", 2) == 0) { op = OP_OR; p += 2; }
+        else if (strncmp(p, "<=", 2) == 0) { op = OP_LE; p += 2; }
+        else if (strncmp(p, ">=", 2) == 0) { op = OP_GE; p += 2; }
+        else if (*p == '<') { op = OP_LT; p++; }
+        else if (*p == '>') { op = OP_GT; p++; }
+        else if (*p == '+') { op = OP_ADD; p++; }
+        else if (*p == '-') { op = OP_SUB; p++; }
+        else if (*p == '*') { op = OP_MUL; p++; }
+        else if (*p == '/') { op = OP_DIV; p++; }
+        else return false;
+
+        // все бинарные операторы левоассоциативны
+        while (ops_count > 0 && ops[ops_count - 1] != OP_LPAREN &&
+               precedence(ops[ops_count - 1]) >= precedence(op))
+        {
+            if (!emit(c, ops[--ops_count], 0, 0, &depth))
+                return false;
+        }
+        if (ops_count == ARRAY_LEN(ops))
+            return false;
+        ops[ops_count++] = op;
+        expect_operand = true;
+    }
+
+    if (expect_operand)
+        return false;
+    while (ops_count > 0)
+    {
+        uint8_t op = ops[--ops_count];
+        if (op == OP_LPAREN || !emit(c, op, 0, 0, &depth))
+            return false;
+    }
+    return depth == 1;
+}
+
+/// @brief кадр, из которого берется переменная
+static uint16_t var_field(uint8_t var)
+{
+    switch (var)
+    {
+    case VAR_AX: case VAR_AY: case VAR_AZ: case VAR_ACC2: return EPOCH_BIT(ACCELERATION);
+    case VAR_GX: case VAR_GY: case VAR_GZ: case VAR_GYRO2: return EPOCH_BIT(ANGULAR_VELONCY);
+    case VAR_ROLL: case VAR_PITCH: case VAR_YAW: return EPOCH_BIT(ANGLE);
+    case VAR_MX: case VAR_MY: case VAR_MZ: return EPOCH_BIT(MAGNETIC);
+    case VAR_TEMP: return EPOCH_BIT(ACCELERATION) | EPOCH_BIT(ANGULAR_VELONCY);
+    default: return 0;
+    }
+}
+
+static double load_var(uint8_t var, const hwt905_values *v)
+{
+    switch (var)
+    {
+    case VAR_AX: case VAR_AY: case VAR_AZ: return v->acceleration[var - VAR_AX];
+    case VAR_GX: case VAR_GY: case VAR_GZ: return v->angularVelocity[var - VAR_GX];
+    case VAR_ROLL: case VAR_PITCH: case VAR_YAW: return v->angle[var - VAR_ROLL];
+    case VAR_MX: case VAR_MY: case VAR_MZ: return v->magneta[var - VAR_MX];
+    case VAR_TEMP: return v->temperature;
+    case VAR_ACC2:
+        return v->acceleration[0] * v->acceleration[0] + v->acceleration[1] * v->acceleration[1] +
+               v->acceleration[2] * v->acceleration[2];
+    case VAR_GYRO2:
+        return v->angularVelocity[0] * v->angularVelocity[0] + v->angularVelocity[1] * v->angularVelocity[1] +
+               v->angularVelocity[2] * v->angularVelocity[2];
+    default: return 0;
+    }
+}
+
+/// @brief вычисление условия на отсчете, глубина стека проверена при компиляции
+static bool evaluate(const trigger_condition *c, const hwt905_values *v)
+{
+    double stack[TRIGGER_STACK_MAX];
+    size_t top = 0;
+
+    for (size_t i = 0; i < c->length; i++)
+    {
+        const trigger_op *op = &c->program[i];
+        double b;
+
+        switch (op->op)
+        {
+        case OP_CONST: stack[top++] = op->value; continue;
+        case OP_VAR: stack[top++] = load_var(op->var, v); continue;
+        case OP_NEG: stack[top - 1] = -stack[top - 1]; continue;
+        case OP_ABS: stack[top - 1] = fabs(stack[top - 1]); continue;
+        default: break;
+        }
+
+        b = stack[--top];
+        double *a = &stack[top - 1];
+        switch (op->op)
+        {
+        case OP_ADD: *a += b; break;
+        case OP_SUB: *a -= b; break;
+        case OP_MUL: *a *= b; break;
+        case OP_DIV: *a /= b; break;
+        case OP_LT: *a = *a < b; break;
+        case OP_GT: *a = *a > b; break;
+        case OP_LE: *a = *a <= b; break;
+        case OP_GE: *a = *a >= b; break;
+        case OP_AND: *a = (*a != 0) && (b != 0); break;
+        case OP_OR: *a = (*a != 0) || (b != 0); break;
+        }
+    }
+    return top == 1 && stack[0] != 0;
+}
+
+void trigger_init(trigger_engine *engine)
+{
+    memset(engine, 0, sizeof(*engine));
+    engine->pre_us = TRIGGER_DEFAULT_PRE_MS * 1000;
+    engine->post_us = TRIGGER_DEFAULT_POST_MS * 1000;
+    engine->armed = true;
+}
+
+/// @brief добавить условие: acc:<порог>, gyro:<порог> или expr:<выражение>
+/// @param engine движок
+/// @param spec описание условия
+/// @return true, если условие разобрано
+bool trigger_add_condition(trigger_engine *engine, const char *spec)
+{
+    if (engine->condition_count == TRIGGER_MAX)
+    {
+        printf("Не больше %d условий срабатывания\n", TRIGGER_MAX);
+        return false;
+    }
+
+    trigger_condition *c = &engine->conditions[engine->condition_count];
+    int depth = 0;
+    bool ok;
+
+    snprintf(c->text, sizeof(c->text), "%s", spec);
+    c->length = 0;
+    c->required = 0;
+    c->uses_temp = false;
+    if (strncasecmp(spec, "acc:", 4) == 0 || strncasecmp(spec, "gyro:", 5) == 0)
+    {
+        // модуль сравнивается в квадрате: acc2 > порог^2
+        bool acc = strncasecmp(spec, "acc:", 4) == 0;
+        char *end;
+        double threshold = strtod(strchr(spec, ':') + 1, &end);
+        ok = *end == '\0' && threshold > 0 &&
+             emit(c, OP_VAR, acc ? VAR_ACC2 : VAR_GYRO2, 0, &depth) &&
+             emit(c, OP_CONST, 0, threshold * threshold, &depth) &&
+             emit(c, OP_GT, 0, 0, &depth);
+    }
+    else if (strncasecmp(spec, "expr:", 5) == 0)
+    {
+        ok = compile_expression(c, spec + 5);
+    }
+    else
+    {
+        ok = false;
+    }
+
+    if (!ok)
+    {
+        printf("Неверное условие срабатывания: %s (acc:<м/с^2>, gyro:<град/с>, expr:<выражение>)\n", spec);
+        return false;
+    }
+    for (size_t i = 0; i < c->length; i++)
+    {
+        if (c->program[i].op != OP_VAR)
+            continue;
+        engine->fields |= var_field(c->program[i].var);
+        if (c->program[i].var == VAR_TEMP)
+            c->uses_temp = true;
+        else
+            c->required |= var_field(c->program[i].var);
+    }
+    engine->condition_count++;
+    return true;
+}
+
+/// @brief разбор окна события "до_мс:после_мс"
+bool trigger_parse_window(trigger_engine *engine, const char *spec)
+{
+    unsigned pre_ms, post_ms;
+
+    if (sscanf(spec, "%u:%u", &pre_ms, &post_ms) != 2 || pre_ms > 60000 || post_ms > 60000)
+    {
+        printf("Неверное окно события: %s (до_мс:после_мс)\n", spec);
+        return false;
+    }
+    engine->pre_us = pre_ms * 1000;
+    engine->post_us = post_ms * 1000;
+    return true;
+}
+
+static void write_event(trigger_engine *engine, const trigger_window *window)
+{
+    trigger_event_info info = {window->number, engine->conditions[window->condition].text,
+                               window->trigger_seq, window->trigger_ts_us, 0, false, ftell(engine->file)};
+    char json[TEXT_JSON_MAX];
+
+    fprintf(engine->file, "{\"event\":%u,\"condition\":\"%s\",\"trigger_seq\":%u,\"trigger_ts_us\":%llu,"
+            "\"pre_ms\":%u,\"post_ms\":%u,\"samples\":[",
+            window->number, info.condition, window->trigger_seq, (unsigned long long)window->trigger_ts_us,
+            engine->pre_us / 1000, engine->post_us / 1000);
+
+    for (uint64_t i = window->first; i < window->end; i++)
+    {
+        trigger_sample sample = engine->history[i & HISTORY_MASK];
+
+        // слот мог быть перезаписан во время копирования: проверяем номер головы после чтения
+        atomic_thread_fence(memory_order_acquire);
+        if (atomic_load_explicit(&engine->head, memory_order_relaxed) >= i + TRIGGER_HISTORY_SLOTS)
+        {
+            info.truncated = true;
+            continue;
+        }
+
+        // в истории хранятся сырые значения, в физические величины они переводятся здесь, вне потока чтения
+        hwt905_epoch epoch;
+        hwt905_sample_to_epoch(&sample, &epoch);
+        size_t len = text_encode_json(json, &epoch, sample.timestamp_us);
+        if (info.samples > 0)
+            fputc(',', engine->file);
+        fwrite(json, 1, len, engine->file);
+        info.samples++;
+    }
+    fprintf(engine->file, "],\"truncated\":%s}\n", info.truncated ? "true" : "false");
+    fflush(engine->file);
+
+    if (engine->on_event != NULL)
+        engine->on_event(&info, engine->on_event_arg);
+}
+
+static void* trigger_thread_function(void *arg)
+{
+    trigger_engine *engine = (trigger_engine*) arg;
+
+    while (true)
+    {
+        if (sem_wait(&engine->pending_sem) != 0 && errno == EINTR)
+            continue;
+
+        uint32_t tail = atomic_load_explicit(&engine->pending_tail, memory_order_relaxed);
+        if (tail == atomic_load_explicit(&engine->pending_head, memory_order_acquire))
+        {
+            if (!engine->running)
+                break;
+            continue;
+        }
+        write_event(engine, &engine->pending[tail % TRIGGER_PENDING_SLOTS]);
+        atomic_store_explicit(&engine->pending_tail, tail + 1, memory_order_release);
+    }
+    return NULL;
+}
+
+/// @brief запуск потока записи событий
+/// @param engine движок с условиями
+/// @param path файл событий (JSON Lines, дописывается)
+/// @param history буфер на TRIGGER_HISTORY_SLOTS отсчетов, если NULL - выделяется aligned_alloc
+/// @param on_event вызывается из потока записи после записи каждого события, может быть NULL
+/// @param arg аргумент on_event
+/// @return true в случае успеха
+bool trigger_start(trigger_engine *engine, const char *path, trigger_sample *history,
+                   trigger_event_fn on_event, void *arg)
+{
+    engine->history = history;
+    if (engine->history == NULL)
+    {
+        engine->history = (trigger_sample*) aligned_alloc(_Alignof(trigger_sample),
+                                                          TRIGGER_HISTORY_SLOTS * sizeof(trigger_sample));
+        if (engine->history == NULL)
+        {
+            printf("Error %i from aligned_alloc: %s\n", errno, strerror(errno));
+            return false;
+        }
+        memset(engine->history, 0, TRIGGER_HISTORY_SLOTS * sizeof(trigger_sample));
+    }
+
+    engine->file = fopen(path, "a");
+    if (engine->file == NULL)
+    {
+        printf("Error %i from fopen %s: %s\n", errno, path, strerror(errno));
+        return false;
+    }
+
+    engine->on_event = on_event;
+    engine->on_event_arg = arg;
+    atomic_store(&engine->head, 0);
+    atomic_store(&engine->pending_head, 0);
+    atomic_store(&engine->pending_tail, 0);
+    sem_init(&engine->pending_sem, 0, 0);
+    engine->running = true;
+
+    if (!rt_thread_create(&engine->thread, TRIGGER_THREAD_STACK, trigger_thread_function, engine))
+    {
+        printf("Error %i from pthread_create: %s\n", errno, strerror(errno));
+        fclose(engine->file);
+        engine->running = false;
+        return false;
+    }
+
+    printf("Триггер: %zu условий, окно %u мс до / %u мс после, события в %s\n",
+           engine->condition_count, engine->pre_us / 1000, engine->post_us / 1000, path);
+    return true;
+}
+
+/// @brief передать закрытое окно потоку записи
+static void close_window(trigger_engine *engine, uint64_t end, trigger_window *closed)
+{
+    uint32_t head = atomic_load_explicit(&engine->pending_head, memory_order_relaxed);
+
+    engine->window.end = end;
+    engine->capturing = false;
+    *closed = engine->window;
+
+    if (head - atomic_load_explicit(&engine->pending_tail, memory_order_acquire) >= TRIGGER_PENDING_SLOTS)
+    {
+        engine->dropped++;
+        return;
+    }
+    engine->pending[head % TRIGGER_PENDING_SLOTS] = engine->window;
+    atomic_store_explicit(&engine->pending_head, head + 1, memory_order_release);
+    sem_post(&engine->pending_sem);
+}
+
+/// @brief добавить отсчет в историю и проверить условия. Вызывается потоком чтения на каждый цикл,
+/// кадры engine->fields должны быть уже преобразованы (epoch_decode)
+/// @param engine движок
+/// @param epoch запись цикла
+/// @param ts_us время отсчета, микросекунды UTC
+/// @param closed окно, закрытое этим отсчетом
+/// @return true, если окно события закрылось и передано на запись
+bool trigger_push(trigger_engine *engine, const hwt905_epoch *epoch, uint64_t ts_us, trigger_window *closed)
+{
+    uint64_t index = atomic_load_explicit(&engine->head, memory_order_relaxed);
+    trigger_sample *slot = &engine->history[index & HISTORY_MASK];
+
+    hwt905_sample_from_epoch(slot, epoch, ts_us);
+    atomic_store_explicit(&engine->head, index + 1, memory_order_release);
+
+    if (engine->capturing)
+    {
+        if (ts_us >= engine->window.trigger_ts_us + engine->post_us ||
+            index + 1 - engine->window.first >= WINDOW_MAX_SAMPLES)
+        {
+            close_window(engine, index + 1, closed);
+            return true;
+        }
+        return false;
+    }
+
+    // условие проверяется только по кадрам этого цикла: в неполном цикле нужных кадров может не быть
+    int fired = -1;
+    bool skipped = false;
+    for (size_t i = 0; i < engine->condition_count; i++)
+    {
+        const trigger_condition *c = &engine->conditions[i];
+        if ((epoch->mask & c->required) != c->required ||
+            (c->uses_temp && !(epoch->mask & (EPOCH_BIT(ACCELERATION) | EPOCH_BIT(ANGULAR_VELONCY)))))
+        {
+            skipped = true;
+            continue;
+        }
+        if (evaluate(c, &epoch->values))
+        {
+            fired = (int)i;
+            break;
+        }
+    }
+    // цикл без кадров условия не меняет состояние фронта
+    if (fired < 0 && skipped)
+        return false;
+
+    // срабатывание по фронту: условие, истинное подряд, не порождает новых событий
+    bool was_armed = engine->armed;
+    engine->armed = fired < 0;
+    if (fired < 0 || !was_armed)
+        return false;
+
+    // начало окна: отсчеты не раньше trigger - pre_us, пока они есть в истории
+    uint64_t first = index;
+    while (first > 0 && index - (first - 1) < WINDOW_MAX_SAMPLES / 2 &&
+           engine->history[(first - 1) & HISTORY_MASK].timestamp_us + engine->pre_us >= ts_us)
+        first--;
+
+    engine->window.number = engine->next_number++;
+    engine->window.first = first;
+    engine->window.trigger = index;
+    engine->window.trigger_ts_us = ts_us;
+    engine->window.trigger_seq = epoch->seq;
+    engine->window.condition = fired;
+    engine->capturing = true;
+    engine->fired++;
+
+    if (engine->post_us == 0)
+    {
+        close_window(engine, index + 1, closed);
+        return true;
+    }
+    return false;
+}
+
+/// @brief остановка потока записи: ожидающие события дописываются
+void trigger_stop(trigger_engine *engine)
+{
+    if (!engine->running)
+        return;
+    engine->running = false;
+    sem_post(&engine->pending_sem);
+    pthread_join(engine->thread, NULL);
+    fclose(engine->file);
+    printf("Триггер: срабатываний %llu, потеряно окон %llu\n",
+           (unsigned long long)engine->fired, (unsigned long long)engine->dropped);
+}
@@ -0,0 +1,117 @@
+#ifndef TRIGGER_H
+#define TRIGGER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <pthread.h>
+#include <semaphore.h>
+
+#include "epoch.h"
+#include "sample.h"
+
+#define TRIGGER_MAX 4              // условий, объединяемых по ИЛИ
+#define TRIGGER_PROGRAM_MAX 64     // инструкций в одном условии
+#define TRIGGER_STACK_MAX 16       // глубина стека вычисления
+#define TRIGGER_HISTORY_SLOTS 1024 // отсчетов в истории, степень двойки (~5 с при 200 Гц)
+#define TRIGGER_PENDING_SLOTS 8    // событий, ожидающих записи
+#define TRIGGER_DEFAULT_PRE_MS 500
+#define TRIGGER_DEFAULT_POST_MS 1000
+#define TRIGGER_THREAD_STACK (64 * 1024) // стек потока записи событий: кодирование JSON и stdio
+#define TRIGGER_DEFAULT_FILE "hwt905_events.jsonl"
+
+/// @brief инструкция условия в обратной польской записи
+typedef struct
+{
+    uint8_t op;
+    uint8_t var;
+    double value;
+} trigger_op;
+
+/// @brief условие срабатывания: acc:<порог> (модуль ускорения, м/с^2), gyro:<порог> (модуль угловой
+/// скорости, град/с) или expr:<выражение> над ax ay az gx gy gz roll pitch yaw mx my mz temp acc2 gyro2.
+/// Все условия компилируются в обратную польскую запись; пороги модуля сравниваются в квадрате, без sqrt
+typedef struct
+{
+    char text[64];
+    trigger_op program[TRIGGER_PROGRAM_MAX];
+    size_t length;
+    uint16_t required;      // кадры, которые должны быть в цикле для проверки условия (биты RSW)
+    bool uses_temp;         // температура есть и в кадре ускорения, и в кадре угловой скорости - нужен любой
+} trigger_condition;
+
+/// @brief отсчет истории: компактная запись цикла (64 байта), timestamp_us - время UTC
+typedef hwt905_sample trigger_sample;
+
+/// @brief окно события, передаваемое потоку записи
+typedef struct
+{
+    uint32_t number;
+    uint64_t first;        // номер первого отсчета окна в истории
+    uint64_t trigger;      // номер отсчета, на котором сработало условие
+    uint64_t end;          // номер после последнего отсчета окна
+    uint64_t trigger_ts_us;
+    uint32_t trigger_seq;
+    int condition;
+} trigger_window;
+
+/// @brief итог записи события: передается в on_event из потока записи
+typedef struct
+{
+    uint32_t number;
+    const char *condition;
+    uint32_t trigger_seq;
+    uint64_t trigger_ts_us;
+    size_t samples;
+    bool truncated;        // часть окна была перезаписана до записи на диск
+    long file_offset;
+} trigger_event_info;
+
+typedef void (*trigger_event_fn)(const trigger_event_info *info, void *arg);
+
+/// @brief движок триггеров. Поток чтения вызывает trigger_push на каждый отсчет:
+/// отсчет пишется в кольцевую историю (один писатель, без блокировок), условия проверяются
+/// по фронту. После срабатывания ждем post_ms, затем окно [trigger - pre_ms, trigger + post_ms]
+/// передается потоку записи, который копирует его из истории и пишет одной строкой JSON
+typedef struct
+{
+    trigger_condition conditions[TRIGGER_MAX];
+    size_t condition_count;
+    uint16_t fields;                    // кадры, которые нужны условиям (биты RSW)
+    uint32_t pre_us;
+    uint32_t post_us;
+
+    trigger_sample *history;            // TRIGGER_HISTORY_SLOTS отсчетов
+    _Atomic uint64_t head;              // номер следующего отсчета, пишет только поток чтения
+
+    bool armed;                         // условие было ложно на предыдущем отсчете
+    bool capturing;
+    trigger_window window;
+    uint32_t next_number;
+
+    trigger_window pending[TRIGGER_PENDING_SLOTS];
+    _Atomic uint32_t pending_head;
+    _Atomic uint32_t pending_tail;
+    sem_t pending_sem;
+
+    FILE *file;
+    pthread_t thread;
+    trigger_event_fn on_event;
+    void *on_event_arg;
+
+    volatile bool running;
+    uint64_t fired;
+    uint64_t dropped;                   // окна, не поместившиеся в очередь записи
+} trigger_engine;
+
+void trigger_init(trigger_engine *engine);
+bool trigger_add_condition(trigger_engine *engine, const char *spec);
+bool trigger_parse_window(trigger_engine *engine, const char *spec);
+bool trigger_start(trigger_engine *engine, const char *path, trigger_sample *history,
+                   trigger_event_fn on_event, void *arg);
+bool trigger_push(trigger_engine *engine, const hwt905_epoch *epoch, uint64_t ts_us, trigger_window *closed);
+void trigger_stop(trigger_engine *engine);
+
+#endif // TRIGGER_H